@@ -0,0 +1,74 @@
+#include "AdapterManager.h"
+
+AdapterManager* AdapterManager::instance() {
+    static AdapterManager manager;
+    return &manager;
+}
+
+void AdapterManager::update(const QBluetoothAddress& address, bool powered) {
+    QMutexLocker locker(&mutex);
+    AdapterInfo* entry = find(address.toUInt64());
+    if (entry) entry->Powered = powered;
+    else entries.append(AdapterInfo { address.toUInt64(), powered, 0 });
+}
+
+void AdapterManager::remove(const QBluetoothAddress& address) {
+    QMutexLocker locker(&mutex);
+    for (int i = 0; i < entries.size(); i++) {
+        if (entries[i].Address != address.toUInt64()) continue;
+        entries.remove(i);
+        return;
+    }
+}
+
+bool AdapterManager::powered(const QBluetoothAddress& address) {
+    QMutexLocker locker(&mutex);
+    AdapterInfo* entry = find(address.toUInt64());
+    return entry && entry->Powered;
+}
+
+QVector<AdapterInfo> AdapterManager::adapters() {
+    QMutexLocker locker(&mutex);
+    return entries;
+}
+
+QBluetoothAddress AdapterManager::select(const QBluetoothAddress& preferred) {
+    if (!preferred.isNull()) return preferred;
+    QMutexLocker locker(&mutex);
+    const AdapterInfo* best = nullptr;
+    for (auto& entry : entries) {
+        if (!entry.Powered) continue;
+        if (!best || entry.Links < best->Links) best = &entry;
+    }
+
+    return best ? QBluetoothAddress(best->Address) : QBluetoothAddress();
+}
+
+void AdapterManager::acquire(const QBluetoothAddress& address) {
+    if (address.isNull()) return;
+    QMutexLocker locker(&mutex);
+    // adapters named by the host before enumeration saw them count as well
+    AdapterInfo* entry = find(address.toUInt64());
+    if (entry) entry->Links++;
+    else entries.append(AdapterInfo { address.toUInt64(), true, 1 });
+}
+
+void AdapterManager::release(const QBluetoothAddress& address) {
+    if (address.isNull()) return;
+    QMutexLocker locker(&mutex);
+    AdapterInfo* entry = find(address.toUInt64());
+    if (entry && entry->Links) entry->Links--;
+}
+
+AdapterInfo* AdapterManager::find(uint64_t address) {
+    for (auto& entry : entries)
+        if (entry.Address == address) return &entry;
+    return nullptr;
+}
+
+uint32_t GetAdapters(AdapterInfo* adapters, uint32_t max) {
+    QVector<AdapterInfo> entries = AdapterManager::instance()->adapters();
+    for (int i = 0; i < entries.size() && static_cast<uint32_t>(i) < max; i++)
+        adapters[i] = entries.at(i);
+    return entries.size();
+}
@@ -0,0 +1,45 @@
+#ifndef ADAPTERMANAGER_H
+#define ADAPTERMANAGER_H
+
+#include <QBluetoothAddress>
+#include <QVector>
+#include <QMutex>
+#include <cstdint>
+
+struct AdapterInfo {
+    uint64_t Address;
+    uint32_t Powered;
+    uint32_t Links;
+};
+
+// Every local adapter the BluetoothAdapter has seen, with its power state
+// and how many links the connection classes hold on it. Connects without
+// an explicit adapter go to the powered one with the fewest links.
+class AdapterManager {
+public:
+    static AdapterManager* instance();
+
+    void update(const QBluetoothAddress& address, bool powered);
+    void remove(const QBluetoothAddress& address);
+    bool powered(const QBluetoothAddress& address);
+    QVector<AdapterInfo> adapters();
+
+    // the preferred adapter when given, otherwise the least loaded powered
+    // one; null when none is known and the backend's default should be used
+    QBluetoothAddress select(const QBluetoothAddress& preferred);
+    void acquire(const QBluetoothAddress& address);
+    void release(const QBluetoothAddress& address);
+
+private:
+    AdapterManager() = default;
+    AdapterInfo* find(uint64_t address);
+
+    QMutex mutex;
+    QVector<AdapterInfo> entries;
+};
+
+extern "C" {
+uint32_t GetAdapters(AdapterInfo* adapters, uint32_t max);
+}
+
+#endif // ADAPTERMANAGER_H
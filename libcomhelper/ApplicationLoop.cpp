@@ -2,10 +2,19 @@
 
 #include <QBluetoothLocalDevice>
 #include <BluetoothAdapter.h>
+#include <BluetoothDiscovery.h>
+#include <Executor.h>
 #include <QThread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
 
-QCoreApplication* app;
-QThread* thread;
+std::atomic<QCoreApplication*> app { nullptr };
+std::atomic<QThread*> thread { nullptr };
+// set by whichever of RunApplication and InitializeAsync gets there first
+static std::atomic<bool> starting { false };
+static constexpr int StartupTimeout = 5000;
 
 QThread* GetMainThread() {
     return thread;
@@ -16,14 +25,62 @@ QCoreApplication* GetApplication() {
 }
 
 void ExitApplication(int code) {
-    app->exit(code);
+    app.load()->exit(code);
 }
 
-int RunApplication() {
+static int runApplication() {
     char* argv[] = { (char*)"remEDIFIER" };
     int argc = 0;
-    app = new QCoreApplication(argc, argv);
+    auto application = new QCoreApplication(argc, argv);
     qRegisterMetaType<bool>();
-    thread = app->thread();
-    return app->exec();
+    thread = application->thread();
+    app = application;
+    return application->exec();
+}
+
+int RunApplication() {
+    // only one QCoreApplication may ever exist
+    if (starting.exchange(true)) return -1;
+    return runApplication();
+}
+
+bool InitializeAsync(ReadyCallback callback, StartupHandles* handles) {
+    if (!handles) return false;
+    // Qt makes the first thread that creates an object its main thread, so
+    // nothing else may touch Qt before the application exists; that part is
+    // quick, enumeration and the discovery agent are the slow ones
+    if (!starting.exchange(true)) std::thread([]() { runApplication(); }).detach();
+    // the host may be starting it on a thread of its own, either way it
+    // has to show up in time
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(StartupTimeout);
+    while (!app) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // one worker each so enumeration and the agent come up side by side
+    Executor::instance()->prestart(2);
+    auto adapter = new BluetoothAdapter();
+    Executor::instance()->attach(adapter);
+    auto discovery = new BluetoothDiscovery(true);
+    Executor::instance()->attach(discovery);
+
+    auto remaining = std::make_shared<std::atomic<int>>(2);
+    auto done = [=]() {
+        if (remaining->fetch_sub(1) == 1 && callback) callback(adapter, discovery);
+    };
+
+    // StartDiscovery and friends queue up behind setup on the same thread
+    QMetaObject::invokeMethod(adapter, [=]() {
+        adapter->enumerate();
+        done();
+    }, Qt::QueuedConnection);
+    QMetaObject::invokeMethod(discovery, [=]() {
+        discovery->setup();
+        done();
+    }, Qt::QueuedConnection);
+
+    handles->Adapter = adapter;
+    handles->Discovery = discovery;
+    return true;
 }
@@ -4,12 +4,24 @@
 #include <QBluetoothDeviceDiscoveryAgent>
 #include <QCoreApplication>
 
+class BluetoothAdapter;
+class BluetoothDiscovery;
+
+struct StartupHandles {
+    BluetoothAdapter* Adapter;
+    BluetoothDiscovery* Discovery;
+};
+
+// called once, from whichever worker finished its part last
+typedef void (*ReadyCallback)(BluetoothAdapter* adapter, BluetoothDiscovery* discovery);
+
 QCoreApplication* GetApplication();
 QThread* GetMainThread();
 
 extern "C" {
 void ExitApplication(int code);
 int RunApplication();
+bool InitializeAsync(ReadyCallback callback, StartupHandles* handles);
 }
 
 #endif // APPLICATIONLOOP_H
@@ -0,0 +1,82 @@
+#include "Arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+static std::atomic<int64_t> liveBlocks { 0 };
+
+Arena::~Arena() {
+    while (head) {
+        Block* next = head->next;
+        free(head);
+        liveBlocks--;
+        head = next;
+    }
+}
+
+void* Arena::alloc(size_t size, size_t align) {
+    if (head) {
+        size_t offset = (head->used + align - 1) & ~(align - 1);
+        if (offset + size <= head->capacity) {
+            head->used = offset + size;
+            char* data = reinterpret_cast<char*>(head + 1) + offset;
+            memset(data, 0, size);
+            return data;
+        }
+    }
+
+    // block data starts max-aligned right after the header
+    size_t capacity = std::max(BlockSize, size);
+    Block* block = static_cast<Block*>(malloc(sizeof(Block) + capacity));
+    if (!block) throw std::bad_alloc();
+    liveBlocks++;
+    block->capacity = capacity;
+    block->used = size;
+    block->next = head;
+    head = block;
+
+    char* data = reinterpret_cast<char*>(block + 1);
+    memset(data, 0, size);
+    return data;
+}
+
+const char* Arena::copy(const QByteArray& data) {
+    char* buf = static_cast<char*>(alloc(data.length() + 1, 1));
+    memcpy(buf, data.constData(), data.length());
+    return buf;
+}
+
+void Arena::reset() {
+    if (!head) return;
+    // keep one block around so per-event arenas stop allocating
+    Block* keep = head;
+    Block* it = head->next;
+    while (it) {
+        Block* next = it->next;
+        free(it);
+        liveBlocks--;
+        it = next;
+    }
+
+    keep->next = nullptr;
+    keep->used = 0;
+}
+
+void Arena::release(void* result) {
+    if (!result) return;
+    delete *reinterpret_cast<Arena**>(static_cast<char*>(result) - HeaderSize);
+}
+
+int64_t Arena::liveAllocations() {
+    return liveBlocks;
+}
+
+void FreeResult(void* result) {
+    Arena::release(result);
+}
+
+int64_t GetLiveAllocations() {
+    return Arena::liveAllocations();
+}
@@ -0,0 +1,58 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QByteArray>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Bump allocator for everything handed across the C boundary. Values
+// returned to the host are rooted in an arena that FreeResult releases
+// in one go, callback payloads live in an arena that is reset as soon
+// as the callback returns.
+class Arena {
+public:
+    static constexpr size_t BlockSize = 512;
+    static constexpr size_t HeaderSize = alignof(std::max_align_t);
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+
+    void* alloc(size_t size, size_t align = alignof(std::max_align_t));
+    const char* copy(const QByteArray& data);
+    void reset();
+
+    template<typename T>
+    T* make(size_t count = 1) {
+        return static_cast<T*>(alloc(sizeof(T) * count, alignof(T)));
+    }
+
+    // first value of a result arena, FreeResult finds the arena through it
+    template<typename T>
+    T* root(size_t size = sizeof(T)) {
+        char* buf = static_cast<char*>(alloc(HeaderSize + size));
+        *reinterpret_cast<Arena**>(buf) = this;
+        return reinterpret_cast<T*>(buf + HeaderSize);
+    }
+
+    static void release(void* result);
+    static int64_t liveAllocations();
+
+private:
+    struct alignas(std::max_align_t) Block {
+        Block* next;
+        size_t capacity;
+        size_t used;
+    };
+
+    Block* head = nullptr;
+};
+
+extern "C" {
+void FreeResult(void* result);
+int64_t GetLiveAllocations();
+}
+
+#endif // ARENA_H
@@ -1,16 +1,23 @@
 #include "BluetoothAdapter.h"
 #include <ApplicationLoop.h>
-#include <qthread.h>
+#include <Executor.h>
+#include <cstring>
 
 BluetoothAdapter* CreateBluetoothAdapter() {
     auto obj = new BluetoothAdapter();
-    QThread* workerThread = new QThread();
-    workerThread->start();
-    obj->moveToThread(workerThread);
+    Executor::instance()->attach(obj);
     QMetaObject::invokeMethod(obj, "enumerate", Qt::BlockingQueuedConnection);
     return obj;
 }
 
+void DestroyBluetoothAdapter(BluetoothAdapter* manager) {
+    Executor::instance()->destroy(manager, [=]() {
+        manager->enabledCallback = nullptr;
+        manager->disabledCallback = nullptr;
+        manager->connectedChangedCallback = nullptr;
+    });
+}
+
 void SetAdapterEnabledCallback(BluetoothAdapter* manager, AdapterCallback callback) {
     manager->enabledCallback = callback;
 }
@@ -20,16 +27,34 @@ void SetAdapterDisabledCallback(BluetoothAdapter* manager, AdapterCallback callb
 }
 
 const char* GetAdapterAddress(BluetoothAdapter* manager) {
-    return strdup(manager->getAddress().toString().toLocal8Bit().data());
+    QByteArray address = manager->getAddress().toString().toLocal8Bit();
+    Arena* arena = new Arena();
+    char* buf = arena->root<char>(address.length() + 1);
+    memcpy(buf, address.constData(), address.length());
+    return buf;
 }
 
 ConnectedDevices* GetConnectedDevices(BluetoothAdapter* manager) {
-    ConnectedDevices* devices;
-    QMetaObject::invokeMethod(manager, "getConnectedDevices",
-        Qt::BlockingQueuedConnection, Q_RETURN_ARG(ConnectedDevices*, devices));
-    return devices;
+    // served from the registry, no need to hop over to the adapter's thread
+    return manager->getConnectedDevices();
 }
 
 bool IsBluetoothAvailable(BluetoothAdapter* manager) {
     return manager->isBluetoothAvailable();
 }
+
+void SetConnectedChangedCallback(BluetoothAdapter* manager, ConnectedChangedCallback callback) {
+    manager->connectedChangedCallback = callback;
+}
+
+uint64_t GetConnectedGeneration(BluetoothAdapter* manager) {
+    return manager->registry.generation();
+}
+
+uint32_t GetConnectedSnapshot(BluetoothAdapter* manager, uint64_t* addresses, uint32_t max, uint64_t* generation) {
+    return manager->registry.snapshot(addresses, max, generation);
+}
+
+int32_t GetConnectedChanges(BluetoothAdapter* manager, uint64_t since, RegistryChange* changes, uint32_t max, uint64_t* generation) {
+    return manager->registry.changes(since, changes, max, generation);
+}
@@ -4,6 +4,14 @@
 #include <QBluetoothLocalDevice>
 #include <QObject>
 #include <QDebug>
+#include <QMap>
+#include <QSet>
+#include <QTimer>
+#include <Arena.h>
+#include <AdapterManager.h>
+#include <Loopback.h>
+#include <EventQueue.h>
+#include <DeviceRegistry.h>
 
 struct ConnectedDevices {
     const char** Addresses;
@@ -13,47 +21,107 @@ struct ConnectedDevices {
 Q_DECLARE_METATYPE(ConnectedDevices*)
 
 typedef void (*AdapterCallback)(const char* address);
+typedef void (*ConnectedChangedCallback)(const char* address, bool connected, uint64_t generation);
 
 class BluetoothAdapter : public QObject {
     Q_OBJECT
 
 private slots:
     void hostModeStateChanged(QBluetoothLocalDevice::HostMode state) {
-        auto device = (QBluetoothLocalDevice)sender();
-        if (!adapter.isNull() && QString::compare(device.address().toString(), adapter.toString()) != 0) return;
-        if (state == QBluetoothLocalDevice::HostPoweredOff) {
+        auto device = qobject_cast<QBluetoothLocalDevice*>(sender());
+        if (!device) return;
+        bool powered = state != QBluetoothLocalDevice::HostPoweredOff;
+        AdapterManager::instance()->update(device->address(), powered);
+        if (!adapter.isNull() && device->address() != adapter) return;
+        if (!powered) {
             adapter = QBluetoothAddress();
-            if (disabledCallback) disabledCallback(strdup(device.address().toString().toLocal8Bit().data()));
-            enumerate(false);
+            QByteArray address = device->address().toString().toLocal8Bit();
+            notify(EventAdapterDisabled, disabledCallback, address);
+            selectPrimary(true);
             return;
         }
 
-        adapter = device.address();
-        if (enabledCallback) enabledCallback(strdup(device.address().toString().toLocal8Bit().data()));
+        adapter = device->address();
+        available = true;
+        QByteArray address = device->address().toString().toLocal8Bit();
+        notify(EventAdapterEnabled, enabledCallback, address);
+        seedRegistry();
+    }
+
+    void onDeviceConnected(const QBluetoothAddress& address) {
+        auto device = qobject_cast<QBluetoothLocalDevice*>(sender());
+        if (device && device->address() == adapter) setConnected(address, true);
+    }
+
+    void onDeviceDisconnected(const QBluetoothAddress& address) {
+        auto device = qobject_cast<QBluetoothLocalDevice*>(sender());
+        if (device && device->address() == adapter) setConnected(address, false);
     }
 
 public slots:
-    void enumerate(bool shouldConnect = true) {
-        auto devices = QBluetoothLocalDevice::allDevices();
-        for (auto it = devices.cbegin(); it != devices.cend(); ++it) {
-            QBluetoothLocalDevice* dev = new QBluetoothLocalDevice(it->address(), this); // memory leak my balls
-            if (adapter.isNull() && dev->isValid() && dev->hostMode() != QBluetoothLocalDevice::HostPoweredOff) adapter = it->address();
-            if (shouldConnect) connect(dev, &QBluetoothLocalDevice::hostModeStateChanged, this, &BluetoothAdapter::hostModeStateChanged, Qt::UniqueConnection);
+    void enumerate() {
+        if (Loopback::enabled()) {
+            adapter = Loopback::adapterAddress();
+            AdapterManager::instance()->update(adapter, true);
+            available = true;
+            seedRegistry();
+            return;
         }
-    }
 
-    ConnectedDevices* getConnectedDevices() {
-        if (adapter.isNull()) return nullptr;
-        ConnectedDevices* info = new ConnectedDevices { 0, 0 };
-        QBluetoothLocalDevice dev(adapter);
-        auto connected = dev.connectedDevices();
-        info->Length = connected.length();
-        info->Addresses = new const char*[info->Length];
-        for (uint32_t i = 0; i < info->Length; i++) {
-            const char* data = strdup(connected.at(i).toString().toLocal8Bit().data());
-            info->Addresses[i] = data;
+        // known adapters keep their objects, later calls only pick up
+        // dongles that were plugged in or pulled since
+        bool startup = !hotplug;
+        QSet<quint64> present;
+        for (auto& info : QBluetoothLocalDevice::allDevices()) {
+            quint64 key = info.address().toUInt64();
+            present.insert(key);
+            if (locals.contains(key)) continue;
+            auto dev = new QBluetoothLocalDevice(info.address(), this);
+            locals.insert(key, dev);
+            connect(dev, &QBluetoothLocalDevice::hostModeStateChanged, this, &BluetoothAdapter::hostModeStateChanged);
+            connect(dev, &QBluetoothLocalDevice::deviceConnected, this, &BluetoothAdapter::onDeviceConnected);
+            connect(dev, &QBluetoothLocalDevice::deviceDisconnected, this, &BluetoothAdapter::onDeviceDisconnected);
+            AdapterManager::instance()->update(info.address(), dev->isValid() && dev->hostMode() != QBluetoothLocalDevice::HostPoweredOff);
+        }
+
+        for (auto it = locals.begin(); it != locals.end();) {
+            if (present.contains(it.key())) {
+                ++it;
+                continue;
+            }
+
+            AdapterManager::instance()->remove(QBluetoothAddress(it.key()));
+            it.value()->deleteLater();
+            it = locals.erase(it);
+        }
+
+        // Qt has no hot-plug signal for adapters, so they are polled
+        if (!hotplug) {
+            hotplug = new QTimer(this);
+            connect(hotplug, &QTimer::timeout, this, &BluetoothAdapter::enumerate);
+            hotplug->start(HotplugInterval);
+        }
+
+        if (!adapter.isNull() && !locals.contains(adapter.toUInt64())) {
+            QByteArray address = adapter.toString().toLocal8Bit();
+            adapter = QBluetoothAddress();
+            notify(EventAdapterDisabled, disabledCallback, address);
         }
 
+        selectPrimary(!startup);
+    }
+
+    ConnectedDevices* getConnectedDevices() {
+        if (!available) return nullptr;
+        uint64_t addresses[DeviceRegistry::Capacity];
+        uint64_t generation;
+        uint32_t count = qMin(registry.snapshot(addresses, DeviceRegistry::Capacity, &generation), DeviceRegistry::Capacity);
+        Arena* arena = new Arena();
+        ConnectedDevices* info = arena->root<ConnectedDevices>();
+        info->Length = count;
+        info->Addresses = arena->make<const char*>(count);
+        for (uint32_t i = 0; i < count; i++)
+            info->Addresses[i] = arena->copy(QBluetoothAddress(addresses[i]).toString().toLocal8Bit());
         return info;
     }
 
@@ -62,24 +130,86 @@ public slots:
     }
 
     bool isBluetoothAvailable() {
-        return !adapter.isNull();
+        return available;
     }
 
 private:
+    void notify(EventType type, AdapterCallback callback, const QByteArray& address) {
+        if (EventQueue::enabled()) EventQueue::instance()->push(type, this, 0, 0, address.constData(), address.length());
+        else if (callback) callback(address.constData());
+    }
+
+    // the primary adapter backs the registry and the adapter callbacks,
+    // the first powered one takes over when it goes away and is announced
+    // like an adapter that was switched on, except for the initial pick
+    void selectPrimary(bool announce) {
+        if (adapter.isNull()) {
+            for (auto dev : qAsConst(locals)) {
+                if (!dev->isValid() || dev->hostMode() == QBluetoothLocalDevice::HostPoweredOff) continue;
+                adapter = dev->address();
+                if (announce) notify(EventAdapterEnabled, enabledCallback, adapter.toString().toLocal8Bit());
+                break;
+            }
+        }
+
+        available = !adapter.isNull();
+        seedRegistry();
+    }
+
+    // the only full query, afterwards the signals keep the registry current
+    void seedRegistry() {
+        if (adapter == seeded) return;
+        seeded = adapter;
+        QList<QBluetoothAddress> connected;
+        if (Loopback::enabled()) {
+            // virtual classic devices count as paired and connected
+            for (auto& device : Loopback::devices())
+                if (!device.lowEnergy) connected.append(device.address);
+        } else if (!adapter.isNull()) {
+            connected = QBluetoothLocalDevice(adapter).connectedDevices();
+        }
+
+        for (auto address : registry.connectedAddresses())
+            if (!connected.contains(QBluetoothAddress(address))) setConnected(QBluetoothAddress(address), false);
+        for (auto& address : connected)
+            setConnected(address, true);
+    }
+
+    void setConnected(const QBluetoothAddress& address, bool connected) {
+        uint64_t generation = registry.update(address.toUInt64(), connected);
+        if (!generation) return;
+        QByteArray buf = address.toString().toLocal8Bit();
+        if (EventQueue::enabled())
+            EventQueue::instance()->push(EventConnectedChanged, this, connected ? 1 : 0, generation, buf.constData(), buf.length());
+        else if (connectedChangedCallback) connectedChangedCallback(buf.constData(), connected, generation);
+    }
+
+    static constexpr int HotplugInterval = 3000;
     QBluetoothAddress adapter;
+    QBluetoothAddress seeded;
+    QMap<quint64, QBluetoothLocalDevice*> locals;
+    QTimer* hotplug = nullptr;
+    std::atomic<bool> available { false };
 
 public:
-    AdapterCallback enabledCallback;
-    AdapterCallback disabledCallback;
+    DeviceRegistry registry;
+    AdapterCallback enabledCallback = nullptr;
+    AdapterCallback disabledCallback = nullptr;
+    ConnectedChangedCallback connectedChangedCallback = nullptr;
 };
 
 extern "C" {
 BluetoothAdapter* CreateBluetoothAdapter();
+void DestroyBluetoothAdapter(BluetoothAdapter* manager);
 void SetAdapterEnabledCallback(BluetoothAdapter* manager, AdapterCallback callback);
 void SetAdapterDisabledCallback(BluetoothAdapter* manager, AdapterCallback callback);
 const char* GetAdapterAddress(BluetoothAdapter* manager);
 ConnectedDevices* GetConnectedDevices(BluetoothAdapter* manager);
 bool IsBluetoothAvailable(BluetoothAdapter* manager);
+void SetConnectedChangedCallback(BluetoothAdapter* manager, ConnectedChangedCallback callback);
+uint64_t GetConnectedGeneration(BluetoothAdapter* manager);
+uint32_t GetConnectedSnapshot(BluetoothAdapter* manager, uint64_t* addresses, uint32_t max, uint64_t* generation);
+int32_t GetConnectedChanges(BluetoothAdapter* manager, uint64_t since, RegistryChange* changes, uint32_t max, uint64_t* generation);
 }
 
 #endif // BLUETOOTHADAPTER_H
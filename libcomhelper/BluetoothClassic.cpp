@@ -1,15 +1,19 @@
 #include "BluetoothClassic.h"
 
-#include <qthread.h>
+#include <Executor.h>
 
 BluetoothClassic* CreateBluetoothClassic() {
     auto obj = new BluetoothClassic();
-    QThread* workerThread = new QThread();
-    workerThread->start();
-    obj->moveToThread(workerThread);
+    Executor::instance()->attach(obj);
     return obj;
 }
 
+void DestroyBluetoothClassic(BluetoothClassic* manager) {
+    Executor::instance()->destroy(manager, [=]() {
+        manager->beginDisconnect();
+    });
+}
+
 void ClassicConnect(BluetoothClassic* manager, const char* address) {
     QMetaObject::invokeMethod(manager, [=]() {
         manager->beginConnect(address);
@@ -38,8 +42,130 @@ void SetClassicDataCallback(BluetoothClassic* manager, DataCallback callback) {
     manager->dataCallback = callback;
 }
 
+void SetClassicWriteCallback(BluetoothClassic* manager, WriteCallback callback) {
+    manager->writeCallback = callback;
+}
+
 void ClassicWrite(BluetoothClassic* manager, const char* data, uint32_t length) {
+    ClassicWriteAsync(manager, data, length);
+}
+
+uint64_t ClassicWriteAsync(BluetoothClassic* manager, const char* data, uint32_t length) {
+    uint64_t id = WriteQueue::nextId();
+    QByteArray buf(data, length);
+    Trace::mark(TraceDispatchPosted, manager, id, length);
+    QMetaObject::invokeMethod(manager, [=]() {
+        Trace::mark(TraceDispatchRun, manager, id);
+        manager->enqueueWrite(id, buf);
+    }, Qt::QueuedConnection);
+    return id;
+}
+
+void SetClassicProtocolVersion(BluetoothClassic* manager, int version) {
+    manager->framer.setProtocolVersion(version);
+}
+
+void GetClassicFramingStats(BluetoothClassic* manager, FramingStats* stats) {
+    *stats = manager->framer.stats();
+}
+
+void GetClassicConnectionStats(BluetoothClassic* manager, ConnectionStats* stats) {
+    *stats = manager->monitor.stats();
+}
+
+void SetClassicTransactCallback(BluetoothClassic* manager, TransactCallback callback) {
+    manager->transactCallback = callback;
+}
+
+uint64_t ClassicTransact(BluetoothClassic* manager, const char* data, uint32_t length, int responseType, int timeout) {
+    uint64_t id = WriteQueue::nextId();
+    QByteArray buf(data, length);
+    Trace::mark(TraceDispatchPosted, manager, id, length);
+    QMetaObject::invokeMethod(manager, [=]() {
+        Trace::mark(TraceDispatchRun, manager, id);
+        manager->transactor->enqueue(PendingTransaction { id, buf, responseType, timeout });
+    }, Qt::QueuedConnection);
+    return id;
+}
+
+bool SetClassicReceiveRing(BluetoothClassic* manager, void* memory, uint32_t size, int mode) {
+    bool result = false;
+    QMetaObject::invokeMethod(manager, [=, &result]() {
+        result = manager->setReceiveRing(memory, size, mode);
+    }, Qt::BlockingQueuedConnection);
+    return result;
+}
+
+void SetClassicReceivedCallback(BluetoothClassic* manager, GenericCallback callback) {
+    manager->receivedCallback = callback;
+}
+
+void ClassicReceiveRingConsumed(BluetoothClassic* manager) {
+    QMetaObject::invokeMethod(manager, [=]() {
+        manager->resumeReceive();
+    }, Qt::QueuedConnection);
+}
+
+void GetClassicReceiveRingStats(BluetoothClassic* manager, ReceiveRingStats* stats) {
+    *stats = manager->ring.stats();
+}
+
+void SetClassicReconnectPolicy(BluetoothClassic* manager, const ReconnectPolicy* policy) {
+    ReconnectPolicy value = *policy;
+    QMetaObject::invokeMethod(manager, [=]() {
+        manager->setReconnectPolicy(value);
+    }, Qt::QueuedConnection);
+}
+
+void SetClassicResumedCallback(BluetoothClassic* manager, GenericCallback callback) {
+    manager->resumedCallback = callback;
+}
+
+int GetClassicReconnectState(BluetoothClassic* manager) {
+    return manager->supervisor->current();
+}
+
+uint64_t AddClassicPoll(BluetoothClassic* manager, uint8_t type, uint32_t interval, uint32_t jitter) {
+    uint64_t id = WriteQueue::nextId();
+    QMetaObject::invokeMethod(manager, [=]() {
+        manager->addPoll(id, type, interval, jitter);
+    }, Qt::QueuedConnection);
+    return id;
+}
+
+void RemoveClassicPoll(BluetoothClassic* manager, uint64_t id) {
     QMetaObject::invokeMethod(manager, [=]() {
-        manager->write(data, length);
+        manager->removePoll(id);
+    }, Qt::QueuedConnection);
+}
+
+bool ReplayClassicCapture(BluetoothClassic* manager, const char* path, uint32_t source, double speed) {
+    bool result = false;
+    QString file = QString::fromUtf8(path);
+    QMetaObject::invokeMethod(manager, [=, &result]() {
+        result = manager->replay(file, source, speed);
     }, Qt::BlockingQueuedConnection);
+    return result;
+}
+
+void StopClassicReplay(BluetoothClassic* manager) {
+    QMetaObject::invokeMethod(manager, [=]() {
+        manager->replayer->stop();
+    }, Qt::QueuedConnection);
+}
+
+bool IsClassicReplaying(BluetoothClassic* manager) {
+    return manager->replayer->running();
+}
+
+void SetClassicStateMirror(BluetoothClassic* manager, bool enabled, bool encrypted) {
+    manager->mirror.setEnabled(enabled, encrypted);
+}
+
+void SetClassicStateChangedCallback(BluetoothClassic* manager, StateCallback callback) {
+    manager->stateCallback = callback;
+}
+
+void GetClassicDeviceSnapshot(BluetoothClassic* manager, DeviceSnapshot* snapshot) {
+    *snapshot = manager->mirror.snapshot();
 }
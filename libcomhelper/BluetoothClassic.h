@@ -3,53 +3,324 @@
 
 #include <QBluetoothSocket>
 #include <BluetoothLowEnergy.h>
+#include <WriteQueue.h>
+#include <Transactor.h>
+#include <Loopback.h>
+#include <EventQueue.h>
+#include <ReceiveRing.h>
+#include <Supervisor.h>
+#include <SessionGroup.h>
+#include <StateCache.h>
+#include <PollScheduler.h>
+#include <Capture.h>
+#include <Trace.h>
+#include <Codec.h>
 #include <QObject>
 
 class BluetoothClassic : public QObject {
     Q_OBJECT
 
+public:
+    BluetoothClassic() {
+        transactor = new Transactor(this);
+        transactor->monitor = &monitor;
+        transactor->send = [this](uint64_t id, const QByteArray& data) {
+            enqueueWrite(id, data);
+        };
+        transactor->completed = [this](uint64_t id, int status, const char* data, uint32_t length) {
+            // polls only feed the mirror, the host never sees them complete
+            if (id == polling) {
+                polling = 0;
+                return;
+            }
+
+            if (SessionGroup::complete(id, status, data, length)) return;
+            notify(EventTransact, status, id, data, length);
+        };
+        writeHandler = [this](uint64_t id, int status) {
+            onWriteFinished(id, status);
+        };
+        supervisor = new Supervisor(this);
+        supervisor->retry = [this]() {
+            reconnect();
+        };
+        replayer = new CaptureReplay(this);
+        replayer->deliver = [this](const CaptureRecord& record, const char* data) {
+            if (record.Kind == CaptureFrame) {
+                onFrameReceived(data, record.Length);
+                return;
+            }
+
+            // error callbacks expect a terminated string
+            QByteArray buf(data, record.Length);
+            notify(static_cast<EventType>(record.Event), record.Code, 0, buf.constData(), buf.length());
+        };
+    }
+
 public slots:
     void beginConnect(const char* address){
+        muted = false;
+        supervisor->start();
+        mirror.reset();
+        remote = QBluetoothAddress(QString::fromUtf8(address));
+        framer.reset();
+        monitor.begin();
+        AdapterManager::instance()->release(localAdapter);
+        // sockets can't be bound to an adapter, the link goes through the default one
+        localAdapter = Loopback::enabled() ? Loopback::adapterAddress() : QBluetoothLocalDevice().address();
+        AdapterManager::instance()->acquire(localAdapter);
+        // the last attempt's transport must not report into this one
+        if (link) {
+            link->disconnect(this);
+            link->deleteLater();
+            link = nullptr;
+            socket = nullptr;
+        }
+
+        if (Loopback::enabled()) {
+            auto virtualLink = new VirtualLink(remote, this);
+            connect(virtualLink, &VirtualLink::connected, this, &BluetoothClassic::onLinkConnected);
+            connect(virtualLink, &VirtualLink::disconnected, this, &BluetoothClassic::onLinkDisconnected);
+            connect(virtualLink, &VirtualLink::errorOccurred, this, &BluetoothClassic::onLinkError);
+            attachLink(virtualLink);
+            virtualLink->open(QIODevice::ReadWrite);
+            return;
+        }
+
         socket = new QBluetoothSocket(QBluetoothServiceInfo::RfcommProtocol, this);
         connect(socket, &QBluetoothSocket::stateChanged, this, &BluetoothClassic::onStateChanged);
-        connect(socket, &QBluetoothSocket::readyRead, this, &BluetoothClassic::onDataReceived);
         connect(socket, QOverload<QBluetoothSocket::SocketError>::of(&QBluetoothSocket::error), this, &BluetoothClassic::onErrorOccurred);
-        socket->connectToService(QBluetoothAddress(QString::fromUtf8(address)), uuid);
+        attachLink(socket);
+        socket->connectToService(remote, uuid);
     }
 
     void beginDisconnect() {
+        supervisor->stop();
+        replayer->stop();
+        connected = false;
+        transactor->abort(WriteAborted);
+        writes.failAll(WriteAborted, writeHandler);
+        monitor.end();
+        stopPolls();
+        AdapterManager::instance()->release(localAdapter);
+        localAdapter = QBluetoothAddress();
         resetCallbacks();
-        socket->disconnectFromService();
-        socket->close();
+        if (!link) return;
+        if (socket) socket->disconnectFromService();
+        link->close();
+    }
+
+    void enqueueWrite(uint64_t id, const QByteArray& data) {
+        if (!link || !connected) {
+            onWriteFinished(id, WriteNotConnected);
+            return;
+        }
+
+        if (data.isEmpty()) {
+            onWriteFinished(id, WriteCompleted);
+            return;
+        }
+
+        Trace::mark(TraceWriteEnqueued, this, id, data.length());
+        if (Capture::active()) Capture::instance()->record(this, CaptureWrite, 0, 0, data.constData(), data.length());
+        writes.enqueue(id, data);
+        scheduleFlush();
     }
 
-    void write(const char* data, uint32_t length) {
-        auto buf = QByteArray::fromRawData(data, length);
-        socket->write(buf);
+    void resumeReceive() {
+        bool wasEmpty;
+        bool drained = ring.flush(&wasEmpty);
+        if (wasEmpty) notify(EventReceived);
+        if (drained && link) onDataReceived();
+    }
+
+    bool setReceiveRing(void* memory, uint32_t size, int mode) {
+        bool result = false;
+        if (memory) result = ring.attach(memory, size, mode);
+        else ring.detach();
+        // a full ring in block mode left bytes in the socket and readyRead
+        // won't come again for them, they go to the new target now
+        if (link && link->bytesAvailable() > 0) onDataReceived();
+        return result;
+    }
+
+    void setReconnectPolicy(const ReconnectPolicy& policy) {
+        supervisor->setPolicy(policy);
+    }
+
+    // plays a capture into this connection as if the device sent it, only
+    // while no real link is up
+    bool replay(const QString& path, uint32_t source, double speed) {
+        if (connected) return false;
+        muted = false;
+        return replayer->start(path, source, speed);
+    }
+
+    void addPoll(uint64_t id, uint8_t type, uint32_t interval, uint32_t jitter) {
+        polls.append(id);
+        PollScheduler::current()->add(id, interval, jitter, [this, type, interval]() {
+            poll(type, interval);
+        });
+    }
+
+    void removePoll(uint64_t id) {
+        if (polls.removeOne(id)) PollScheduler::current()->remove(id);
     }
 
 private slots:
+    void attachLink(QIODevice* device) {
+        link = device;
+        connect(link, &QIODevice::readyRead, this, &BluetoothClassic::onDataReceived);
+        connect(link, &QIODevice::bytesWritten, this, &BluetoothClassic::onBytesWritten);
+    }
+
     void onStateChanged() {
         QBluetoothSocket::SocketState state = socket->state();
-        if (state == QBluetoothSocket::ConnectedState){
-            if (connectedCallback) connectedCallback();
-        }
+        if (state == QBluetoothSocket::ConnectedState) onLinkConnected();
+        if (state == QBluetoothSocket::UnconnectedState) onLinkDisconnected();
+    }
 
-        if (state == QBluetoothSocket::UnconnectedState){
-            if (disconnectedCallback) disconnectedCallback();
-            beginDisconnect();
-        }
+    void onLinkConnected() {
+        connected = true;
+        monitor.mark(PhaseLinkConnected);
+        monitor.mark(PhaseReady);
+        notify(supervisor->ready() ? EventResumed : EventConnected);
+    }
+
+    void onLinkDisconnected() {
+        if (suspend()) return;
+        notify(EventDisconnected);
+        beginDisconnect();
     }
 
     void onErrorOccurred() {
-        if (errorCallback) errorCallback(strdup(socket->errorString().toLocal8Bit().data()), socket->error());
+        if (suspend()) return;
+        QByteArray message = socket->errorString().toLocal8Bit();
+        notifyError(message.constData(), socket->error());
         beginDisconnect();
     }
 
+    void onLinkError(const QString& message) {
+        if (suspend()) return;
+        QByteArray buf = message.toLocal8Bit();
+        notifyError(buf.constData(), -1);
+        beginDisconnect();
+    }
+
+    // a supervised link dropped: pending work fails, but the callbacks and
+    // the socket stay for the next attempt
+    bool suspend() {
+        if (supervisor->waiting()) return true;
+        if (!supervisor->lost()) return false;
+        connected = false;
+        transactor->abort(WriteAborted);
+        writes.failAll(WriteAborted, writeHandler);
+        monitor.end();
+        if (link && link->isOpen()) link->close();
+        return true;
+    }
+
+    void reconnect() {
+        framer.reset();
+        monitor.begin();
+        if (socket) socket->connectToService(remote, uuid);
+        else if (link) link->open(QIODevice::ReadWrite);
+    }
+
+    void onWriteFinished(uint64_t id, int status) {
+        // writes issued on behalf of a transaction are reported through it
+        if (transactor->owns(id)) {
+            transactor->writeFinished(id, status);
+            return;
+        }
+
+        notify(EventWrite, status, id);
+    }
+
+    void flushWrites() {
+        flushScheduled = false;
+        if (!link || !writes.hasQueued()) return;
+        QByteArray buf = writes.takeCoalesced(CoalesceLimit);
+        Trace::mark(TraceSocketWrite, this, 0, buf.length());
+        if (link->write(buf) < 0)
+            writes.failInflight(WriteFailed, writeHandler);
+        else monitor.wrote(buf.length());
+        // whatever didn't fit under the coalescing limit goes in the next one
+        if (writes.hasQueued()) scheduleFlush();
+    }
+
+    void scheduleFlush() {
+        if (flushScheduled) return;
+        flushScheduled = true;
+        // let writes already posted to this thread join the same flush
+        QMetaObject::invokeMethod(this, &BluetoothClassic::flushWrites, Qt::QueuedConnection);
+    }
+
+    void onBytesWritten(qint64 bytes) {
+        Trace::mark(TraceBytesWritten, this, 0, bytes);
+        writes.acknowledge(bytes, writeHandler);
+    }
+
     void onDataReceived() {
-        QByteArray value = socket->readAll();
-        if (!dataCallback) return;
-        dataCallback(value.data(), value.length());
+        // RFCOMM is a stream, read straight into the framer's ring; with the
+        // host's receive ring full the rest waits in the socket
+        while (link->bytesAvailable() > 0 && !ring.stalled()) {
+            uint32_t available;
+            char* buf = framer.reserve(&available);
+            qint64 count = link->read(buf, available);
+            if (count <= 0) break;
+            Trace::mark(TraceNotification, this, 0, count);
+            monitor.received(count);
+            framer.commit(count, [this](const char* data, uint32_t length) {
+                onFrameReceived(data, length);
+            });
+        }
+    }
+
+    void onFrameReceived(const char* data, uint32_t length) {
+        if (Capture::active()) Capture::instance()->record(this, CaptureFrame, 0, 0, data, length);
+        // the mirror sees every frame, answers to transactions included
+        if (mirror.enabled()) {
+            uint32_t changed = mirror.update(data, length);
+            if (changed) {
+                DeviceSnapshot snapshot = mirror.snapshot();
+                notify(EventStateChanged, changed, snapshot.Sequence, reinterpret_cast<const char*>(&snapshot), sizeof(snapshot));
+            }
+        }
+
+        if (transactor->consume(data, length)) return;
+        if (ring.attached()) {
+            bool wasEmpty;
+            ring.offer(data, length, &wasEmpty);
+            if (wasEmpty) notify(EventReceived);
+            return;
+        }
+
+        notify(EventData, 0, 0, data, length);
+    }
+
+    // one poll in flight per device, and none when a frame reported the
+    // field within the interval anyway
+    void poll(uint8_t type, uint32_t interval) {
+        if (!connected || polling) return;
+        uint32_t field = StateCache::field(type);
+        if (field && mirror.enabled()) {
+            int64_t age = mirror.age(field);
+            if (age >= 0 && age < interval) return;
+        }
+
+        int version = framer.protocolVersion();
+        if (!version) version = framer.detectedVersion();
+        uint8_t frame[8];
+        int32_t length = Codec::encode(version, mirror.encrypted(), type, nullptr, 0, frame, sizeof(frame));
+        if (length < 0) return;
+        polling = WriteQueue::nextId();
+        transactor->enqueue(PendingTransaction { polling, QByteArray(reinterpret_cast<char*>(frame), length), type, PollTimeout });
+    }
+
+    void stopPolls() {
+        for (uint64_t id : polls) PollScheduler::current()->remove(id);
+        polls.clear();
     }
 
     void resetCallbacks() {
@@ -57,28 +328,133 @@ private slots:
         connectedCallback = nullptr;
         errorCallback = nullptr;
         dataCallback = nullptr;
+        writeCallback = nullptr;
+        transactCallback = nullptr;
+        receivedCallback = nullptr;
+        resumedCallback = nullptr;
+        stateCallback = nullptr;
+        muted = true;
     }
 
 private:
+    // every event goes out here, into the event queue when the host enabled
+    // it and to the per-object callbacks otherwise
+    void notify(EventType type, int code = 0, uint64_t id = 0, const char* data = nullptr, uint32_t length = 0) {
+        if (Capture::active() && (type <= EventError || type == EventResumed))
+            Capture::instance()->record(this, CaptureEvent, type, code, data, length);
+        if (EventQueue::enabled()) {
+            if (!muted) EventQueue::instance()->push(type, this, code, id, data, length);
+            return;
+        }
+
+        Trace::mark(TraceCallbackEnter, this, id, type);
+        switch (type) {
+        case EventConnected:
+            if (connectedCallback) connectedCallback();
+            break;
+        case EventDisconnected:
+            if (disconnectedCallback) disconnectedCallback();
+            break;
+        case EventError:
+            if (errorCallback) errorCallback(data, code);
+            break;
+        case EventData:
+            if (dataCallback) dataCallback(data, length);
+            break;
+        case EventWrite:
+            if (writeCallback) writeCallback(id, code);
+            break;
+        case EventTransact:
+            if (transactCallback) transactCallback(id, code, data, length);
+            break;
+        case EventReceived:
+            if (receivedCallback) receivedCallback();
+            break;
+        case EventResumed:
+            if (resumedCallback) resumedCallback();
+            break;
+        case EventStateChanged:
+            if (stateCallback) stateCallback(code, reinterpret_cast<const DeviceSnapshot*>(data));
+            break;
+        default:
+            break;
+        }
+
+        Trace::mark(TraceCallbackExit, this, id, type);
+    }
+
+    void notifyError(const char* message, int code) {
+        notify(EventError, code, 0, message, static_cast<uint32_t>(strlen(message)));
+    }
+
     const QBluetoothUuid uuid = QBluetoothUuid(QStringLiteral("EDF00000-EDFE-DFED-FEDF-EDFEDFEDFEDF"));
-    QBluetoothSocket* socket;
+    static constexpr int CoalesceLimit = 1024;
+    static constexpr int PollTimeout = 1000;
+    QBluetoothSocket* socket = nullptr;
+    QIODevice* link = nullptr;
+    QBluetoothAddress remote;
+    QBluetoothAddress localAdapter;
+    bool connected = false;
+    bool muted = false;
+    WriteQueue writes;
+    WriteHandler writeHandler;
+    bool flushScheduled = false;
+    QList<uint64_t> polls;
+    uint64_t polling = 0;
+
+public:
+    FrameAssembler framer;
+    ReceiveRing ring;
+    StateCache mirror;
+    ConnectionMonitor monitor { ConnectionClassic };
+    Supervisor* supervisor;
+    CaptureReplay* replayer;
 
 public:
-    GenericCallback disconnectedCallback;
-    GenericCallback connectedCallback;
-    ErrorCallback errorCallback;
-    DataCallback dataCallback;
+    GenericCallback disconnectedCallback = nullptr;
+    GenericCallback connectedCallback = nullptr;
+    ErrorCallback errorCallback = nullptr;
+    DataCallback dataCallback = nullptr;
+    WriteCallback writeCallback = nullptr;
+    TransactCallback transactCallback = nullptr;
+    GenericCallback receivedCallback = nullptr;
+    GenericCallback resumedCallback = nullptr;
+    StateCallback stateCallback = nullptr;
+    Transactor* transactor;
 };
 
 extern "C" {
 BluetoothClassic* CreateBluetoothClassic();
+void DestroyBluetoothClassic(BluetoothClassic* manager);
 void ClassicConnect(BluetoothClassic* manager, const char* address);
 void ClassicDisconnect(BluetoothClassic* manager);
 void SetClassicDisconnectedCallback(BluetoothClassic* manager, GenericCallback callback);
 void SetClassicConnectedCallback(BluetoothClassic* manager, GenericCallback callback);
 void SetClassicErrorCallback(BluetoothClassic* manager, ErrorCallback callback);
 void SetClassicDataCallback(BluetoothClassic* manager, DataCallback callback);
+void SetClassicWriteCallback(BluetoothClassic* manager, WriteCallback callback);
 void ClassicWrite(BluetoothClassic* manager, const char* data, uint32_t length);
+uint64_t ClassicWriteAsync(BluetoothClassic* manager, const char* data, uint32_t length);
+void SetClassicTransactCallback(BluetoothClassic* manager, TransactCallback callback);
+uint64_t ClassicTransact(BluetoothClassic* manager, const char* data, uint32_t length, int responseType, int timeout);
+void SetClassicProtocolVersion(BluetoothClassic* manager, int version);
+void GetClassicFramingStats(BluetoothClassic* manager, FramingStats* stats);
+void GetClassicConnectionStats(BluetoothClassic* manager, ConnectionStats* stats);
+bool SetClassicReceiveRing(BluetoothClassic* manager, void* memory, uint32_t size, int mode);
+void SetClassicReceivedCallback(BluetoothClassic* manager, GenericCallback callback);
+void ClassicReceiveRingConsumed(BluetoothClassic* manager);
+void GetClassicReceiveRingStats(BluetoothClassic* manager, ReceiveRingStats* stats);
+void SetClassicReconnectPolicy(BluetoothClassic* manager, const ReconnectPolicy* policy);
+void SetClassicResumedCallback(BluetoothClassic* manager, GenericCallback callback);
+int GetClassicReconnectState(BluetoothClassic* manager);
+uint64_t AddClassicPoll(BluetoothClassic* manager, uint8_t type, uint32_t interval, uint32_t jitter);
+void RemoveClassicPoll(BluetoothClassic* manager, uint64_t id);
+bool ReplayClassicCapture(BluetoothClassic* manager, const char* path, uint32_t source, double speed);
+void StopClassicReplay(BluetoothClassic* manager);
+bool IsClassicReplaying(BluetoothClassic* manager);
+void SetClassicStateMirror(BluetoothClassic* manager, bool enabled, bool encrypted);
+void SetClassicStateChangedCallback(BluetoothClassic* manager, StateCallback callback);
+void GetClassicDeviceSnapshot(BluetoothClassic* manager, DeviceSnapshot* snapshot);
 }
 
 #endif // BLUETOOTHCLASSIC_H
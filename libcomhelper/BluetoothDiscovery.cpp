@@ -4,17 +4,23 @@
 #include <QBluetoothLocalDevice>
 #include <QBluetoothDeviceInfo>
 #include <ApplicationLoop.h>
-#include <QThread>
+#include <Executor.h>
 #include <QTimer>
 
 BluetoothDiscovery* CreateDiscovery() {
     auto obj = new BluetoothDiscovery();
-    QThread* workerThread = new QThread();
-    workerThread->start();
-    obj->moveToThread(workerThread);
+    Executor::instance()->attach(obj);
     return obj;
 }
 
+void DestroyDiscovery(BluetoothDiscovery* wrapper) {
+    Executor::instance()->destroy(wrapper, [=]() {
+        wrapper->discoveredCallback = nullptr;
+        wrapper->finishedCallback = nullptr;
+        wrapper->stopDiscovery();
+    });
+}
+
 void SetDeviceDiscoveredCallback(BluetoothDiscovery* wrapper, DeviceDiscoveredCallback callback) {
     wrapper->discoveredCallback = callback;
 }
@@ -34,3 +40,52 @@ void StopDiscovery(BluetoothDiscovery* wrapper) {
         wrapper->stopDiscovery();
     });
 }
+
+void SetDiscoveryManufacturerIds(BluetoothDiscovery* wrapper, const uint16_t* ids, uint32_t length) {
+    QSet<quint16> set;
+    for (uint32_t i = 0; i < length; i++)
+        set.insert(ids[i]);
+    QMetaObject::invokeMethod(wrapper, [=]() {
+        wrapper->setManufacturerIds(set);
+    });
+}
+
+void SetDiscoveryServiceUuids(BluetoothDiscovery* wrapper, const char** uuids, uint32_t length) {
+    QList<QBluetoothUuid> list;
+    for (uint32_t i = 0; i < length; i++)
+        list.append(QBluetoothUuid(QString::fromUtf8(uuids[i])));
+    QMetaObject::invokeMethod(wrapper, [=]() {
+        wrapper->setServiceUuids(list);
+    });
+}
+
+void SetDiscoveryNamePrefix(BluetoothDiscovery* wrapper, const char* prefix) {
+    QString str = prefix ? QString::fromUtf8(prefix) : QString();
+    QMetaObject::invokeMethod(wrapper, [=]() {
+        wrapper->setNamePrefix(str);
+    });
+}
+
+void SetDiscoveryMethods(BluetoothDiscovery* wrapper, int methods) {
+    QMetaObject::invokeMethod(wrapper, [=]() {
+        wrapper->setMethods(methods);
+    });
+}
+
+void SetDiscoveryDeduplication(BluetoothDiscovery* wrapper, bool enabled) {
+    QMetaObject::invokeMethod(wrapper, [=]() {
+        wrapper->setDeduplication(enabled);
+    });
+}
+
+void ResetDiscoveryCache(BluetoothDiscovery* wrapper) {
+    QMetaObject::invokeMethod(wrapper, [=]() {
+        wrapper->resetCache();
+    });
+}
+
+void GetDiscoveryStats(BluetoothDiscovery* wrapper, DiscoveryStats* stats) {
+    *stats = DiscoveryStats {
+        wrapper->reported, wrapper->filtered, wrapper->duplicates
+    };
+}
@@ -6,6 +6,12 @@
 #include <QObject>
 #include <QDebug>
 #include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <Arena.h>
+#include <Loopback.h>
+#include <EventQueue.h>
+#include <atomic>
 
 struct DeviceInfo {
     const char* DeviceName;
@@ -20,6 +26,17 @@ struct DeviceInfo {
     uint32_t MinorDeviceClass;
 };
 
+struct DiscoveryStats {
+    uint64_t Reported;
+    uint64_t Filtered;
+    uint64_t Duplicates;
+};
+
+enum DiscoveryMethod {
+    DiscoverClassic = 1,
+    DiscoverLowEnergy = 2
+};
+
 typedef void (*DeviceDiscoveredCallback)(DeviceInfo info);
 typedef void (*DiscoveryFinishedCallback)();
 
@@ -27,23 +44,93 @@ class BluetoothDiscovery : public QObject {
     Q_OBJECT
 
 public:
-    BluetoothDiscovery() {
+    // a deferred discovery creates its agent in setup(), on its own thread
+    explicit BluetoothDiscovery(bool deferred = false) {
+        if (!deferred) setup();
+    }
+
+public slots:
+    void setup() {
+        if (discoveryAgent) return;
         discoveryAgent = new QBluetoothDeviceDiscoveryAgent(this);
         connect(discoveryAgent, &QBluetoothDeviceDiscoveryAgent::deviceDiscovered, this, &BluetoothDiscovery::onDeviceDiscovered);
+        connect(discoveryAgent, &QBluetoothDeviceDiscoveryAgent::deviceUpdated, this, [this](const QBluetoothDeviceInfo& deviceInfo) {
+            // without deduplication every advertisement would be reported again
+            if (deduplicate) onDeviceDiscovered(deviceInfo);
+        });
         connect(discoveryAgent, &QBluetoothDeviceDiscoveryAgent::finished, this, &BluetoothDiscovery::onFinished);
     }
 
-public slots:
     void startDiscovery() {
-        discoveryAgent->start(QBluetoothDeviceDiscoveryAgent::ClassicMethod | QBluetoothDeviceDiscoveryAgent::LowEnergyMethod);
+        if (Loopback::enabled()) {
+            advertiseVirtualDevices();
+            return;
+        }
+
+        QBluetoothDeviceDiscoveryAgent::DiscoveryMethods agentMethods;
+        if (methods & DiscoverClassic) agentMethods |= QBluetoothDeviceDiscoveryAgent::ClassicMethod;
+        if (methods & DiscoverLowEnergy) agentMethods |= QBluetoothDeviceDiscoveryAgent::LowEnergyMethod;
+        setup();
+        discoveryAgent->start(agentMethods);
+    }
+
+    void setManufacturerIds(const QSet<quint16>& ids) {
+        manufacturerIds = ids;
+    }
+
+    void setServiceUuids(const QList<QBluetoothUuid>& uuids) {
+        serviceUuids = uuids;
+    }
+
+    void setNamePrefix(const QString& prefix) {
+        namePrefix = prefix;
+    }
+
+    void setMethods(int methods) {
+        this->methods = methods;
+    }
+
+    void setDeduplication(bool enabled) {
+        deduplicate = enabled;
+        seen.clear();
+    }
+
+    void resetCache() {
+        seen.clear();
     }
 
     void stopDiscovery() {
-        discoveryAgent->stop();
+        // pending virtual advertisements check the generation and give up
+        generation++;
+        if (discoveryAgent) discoveryAgent->stop();
     }
 
 private slots:
     void onDeviceDiscovered(const QBluetoothDeviceInfo& deviceInfo) {
+        if (!matches(deviceInfo)) {
+            filtered++;
+            return;
+        }
+
+        if (deduplicate) {
+            // only new devices or ones whose advertised fields changed
+            QString key = deviceInfo.address().isNull()
+                ? deviceInfo.deviceUuid().toString() : deviceInfo.address().toString();
+            uint hash = fingerprint(deviceInfo);
+            auto it = seen.constFind(key);
+            if (it != seen.constEnd() && it.value() == hash) {
+                duplicates++;
+                return;
+            }
+
+            seen.insert(key, hash);
+        }
+
+        if (EventQueue::enabled()) {
+            pushDiscovered(deviceInfo);
+            return;
+        }
+
         if (discoveredCallback) {
             QByteArray nameBuf = deviceInfo.name().toLocal8Bit();
 #ifdef Q_OS_MAC
@@ -52,52 +139,175 @@ private slots:
             QByteArray addressBuf = deviceInfo.address().toString().toLocal8Bit();
 #endif
             DeviceInfo info{0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-            info.DeviceName = strdup(nameBuf.data());
-            info.MacAddress = strdup(addressBuf.data());
             info.IsLowEnergyDevice = deviceInfo.coreConfigurations() & QBluetoothDeviceInfo::LowEnergyCoreConfiguration;
+            QHash<unsigned short, QByteArray> data = deviceInfo.manufacturerData();
+            if (info.IsLowEnergyDevice && data.empty()) return;
+            // everything below is only valid while the callback runs
+            info.DeviceName = arena.copy(nameBuf);
+            info.MacAddress = arena.copy(addressBuf);
             if (info.IsLowEnergyDevice) {
-                QHash<unsigned short, QByteArray> data = deviceInfo.manufacturerData();
-                if (data.empty()) return;
                 QList<QBluetoothUuid> uuids = deviceInfo.serviceUuids();
-                info.ServiceUuids = new const char*[uuids.length()];
-                for (int i = 0; i < uuids.length(); i++) {
-                    const char* data = strdup(uuids.at(i).toString().toLocal8Bit().data());
-                    info.ServiceUuids[i] = data;
-                }
+                info.ServiceUuids = arena.make<const char*>(uuids.length());
+                for (int i = 0; i < uuids.length(); i++)
+                    info.ServiceUuids[i] = arena.copy(uuids.at(i).toString().toLocal8Bit());
                 info.ServiceUuidsLength = uuids.length();
-                info.ManufacturerId = data.keys().constFirst();
-                QByteArray buffer = data.values().constFirst();
-                info.ManufacturerData = strdup(buffer.data());
+                info.ManufacturerId = data.constBegin().key();
+                QByteArray buffer = data.constBegin().value();
+                info.ManufacturerData = arena.copy(buffer);
                 info.ManufacturerDataLength = buffer.length();
             } else {
                 info.MajorDeviceClass = deviceInfo.majorDeviceClass();
                 info.MinorDeviceClass = deviceInfo.minorDeviceClass();
             }
 
+            reported++;
             discoveredCallback(info);
+            arena.reset();
         }
     }
 
+    void pushDiscovered(const QBluetoothDeviceInfo& deviceInfo) {
+        bool lowEnergy = deviceInfo.coreConfigurations() & QBluetoothDeviceInfo::LowEnergyCoreConfiguration;
+        QHash<unsigned short, QByteArray> data = deviceInfo.manufacturerData();
+        if (lowEnergy && data.empty()) return;
+        // same fields as DeviceInfo, flattened into the event payload
+        QByteArray payload = deviceInfo.name().toLocal8Bit();
+        payload.append('\0');
+#ifdef Q_OS_MAC
+        payload.append(deviceInfo.deviceUuid().toString().toLocal8Bit());
+#else
+        payload.append(deviceInfo.address().toString().toLocal8Bit());
+#endif
+        payload.append('\0');
+        uint64_t id;
+        if (lowEnergy) {
+            for (auto& uuid : deviceInfo.serviceUuids()) {
+                payload.append(uuid.toString().toLocal8Bit());
+                payload.append('\0');
+            }
+
+            payload.append('\0');
+            payload.append(data.constBegin().value());
+            id = data.constBegin().key();
+        } else {
+            payload.append('\0');
+            id = static_cast<uint64_t>(deviceInfo.majorDeviceClass()) << 16
+                | static_cast<uint64_t>(deviceInfo.minorDeviceClass()) << 32;
+        }
+
+        reported++;
+        EventQueue::instance()->push(EventDiscovered, this, lowEnergy ? 1 : 0, id, payload.constData(), payload.length());
+    }
+
+    bool matches(const QBluetoothDeviceInfo& deviceInfo) const {
+        auto config = deviceInfo.coreConfigurations();
+        if (!(methods & DiscoverLowEnergy) && !(config & QBluetoothDeviceInfo::BaseRateCoreConfiguration)) return false;
+        if (!(methods & DiscoverClassic) && !(config & QBluetoothDeviceInfo::LowEnergyCoreConfiguration)) return false;
+        if (!namePrefix.isEmpty() && !deviceInfo.name().startsWith(namePrefix)) return false;
+        if (!manufacturerIds.isEmpty()) {
+            bool found = false;
+            for (auto id : deviceInfo.manufacturerIds())
+                if (manufacturerIds.contains(id)) found = true;
+            if (!found) return false;
+        }
+
+        if (!serviceUuids.isEmpty()) {
+            bool found = false;
+            for (auto& uuid : deviceInfo.serviceUuids())
+                if (serviceUuids.contains(uuid)) found = true;
+            if (!found) return false;
+        }
+
+        return true;
+    }
+
+    uint fingerprint(const QBluetoothDeviceInfo& deviceInfo) const {
+        uint hash = qHash(deviceInfo.name());
+        auto mix = [&hash](uint value) {
+            hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        };
+
+        mix(static_cast<uint>(deviceInfo.coreConfigurations()));
+        mix(deviceInfo.majorDeviceClass());
+        mix(deviceInfo.minorDeviceClass());
+        for (auto& uuid : deviceInfo.serviceUuids())
+            mix(qHash(uuid));
+        auto data = deviceInfo.manufacturerData();
+        for (auto it = data.constBegin(); it != data.constEnd(); ++it) {
+            mix(it.key());
+            mix(qHash(it.value()));
+        }
+
+        return hash;
+    }
+
+    void advertiseVirtualDevices() {
+        const QList<VirtualDeviceInfo> devices = Loopback::devices();
+        int current = ++generation;
+        int interval = Loopback::config().AdvertisingInterval;
+        int delay = 0;
+        for (auto& device : devices) {
+            QBluetoothDeviceInfo deviceInfo(device.address, device.name, device.classOfDevice);
+            if (device.lowEnergy) deviceInfo.setCoreConfigurations(QBluetoothDeviceInfo::LowEnergyCoreConfiguration);
+            if (!device.serviceUuids.isEmpty()) deviceInfo.setServiceUuids(device.serviceUuids);
+            if (!device.manufacturerData.isEmpty()) deviceInfo.setManufacturerData(device.manufacturerId, device.manufacturerData);
+            delay += interval;
+            QTimer::singleShot(delay, this, [this, deviceInfo, current]() {
+                if (current == generation) onDeviceDiscovered(deviceInfo);
+            });
+        }
+
+        QTimer::singleShot(delay + interval, this, [this, current]() {
+            if (current == generation) onFinished();
+        });
+    }
+
     void onFinished() {
+        if (EventQueue::enabled()) {
+            EventQueue::instance()->push(EventDiscoveryFinished, this);
+            return;
+        }
+
         if (finishedCallback) {
             finishedCallback();
         }
     }
 
 private:
-    QBluetoothDeviceDiscoveryAgent* discoveryAgent;
+    QBluetoothDeviceDiscoveryAgent* discoveryAgent = nullptr;
+    QSet<quint16> manufacturerIds;
+    QList<QBluetoothUuid> serviceUuids;
+    QString namePrefix;
+    int methods = DiscoverClassic | DiscoverLowEnergy;
+    bool deduplicate = false;
+    int generation = 0;
+    QHash<QString, uint> seen;
+    Arena arena;
+
+public:
+    std::atomic<uint64_t> reported { 0 };
+    std::atomic<uint64_t> filtered { 0 };
+    std::atomic<uint64_t> duplicates { 0 };
 
 public:
-    DeviceDiscoveredCallback discoveredCallback;
-    DiscoveryFinishedCallback finishedCallback;
+    DeviceDiscoveredCallback discoveredCallback = nullptr;
+    DiscoveryFinishedCallback finishedCallback = nullptr;
 };
 
 extern "C" {
 BluetoothDiscovery* CreateDiscovery();
+void DestroyDiscovery(BluetoothDiscovery* wrapper);
 void SetDeviceDiscoveredCallback(BluetoothDiscovery* wrapper, DeviceDiscoveredCallback callback);
 void SetDiscoveryFinishedCallback(BluetoothDiscovery* wrapper, DiscoveryFinishedCallback callback);
 void StartDiscovery(BluetoothDiscovery* wrapper);
 void StopDiscovery(BluetoothDiscovery* wrapper);
+void SetDiscoveryManufacturerIds(BluetoothDiscovery* wrapper, const uint16_t* ids, uint32_t length);
+void SetDiscoveryServiceUuids(BluetoothDiscovery* wrapper, const char** uuids, uint32_t length);
+void SetDiscoveryNamePrefix(BluetoothDiscovery* wrapper, const char* prefix);
+void SetDiscoveryMethods(BluetoothDiscovery* wrapper, int methods);
+void SetDiscoveryDeduplication(BluetoothDiscovery* wrapper, bool enabled);
+void ResetDiscoveryCache(BluetoothDiscovery* wrapper);
+void GetDiscoveryStats(BluetoothDiscovery* wrapper, DiscoveryStats* stats);
 }
 
 #endif // BLUETOOTHDISCOVERY_H
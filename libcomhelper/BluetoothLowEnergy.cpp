@@ -1,15 +1,19 @@
 #include "BluetoothLowEnergy.h"
 
-#include <qthread.h>
+#include <Executor.h>
 
 BluetoothLowEnergy* CreateBluetoothLowEnergy() {
     auto obj = new BluetoothLowEnergy();
-    QThread* workerThread = new QThread();
-    workerThread->start();
-    obj->moveToThread(workerThread);
+    Executor::instance()->attach(obj);
     return obj;
 }
 
+void DestroyBluetoothLowEnergy(BluetoothLowEnergy* manager) {
+    Executor::instance()->destroy(manager, [=]() {
+        manager->beginDisconnect();
+    });
+}
+
 void LowEnergyConnect(BluetoothLowEnergy* manager, const char* localAddress, const char* macAddress, const char* serviceUuid, const char* writeUuid, const char* readUuid) {
     QMetaObject::invokeMethod(manager, [=]() {
         manager->beginConnect(localAddress, macAddress, serviceUuid, writeUuid, readUuid);
@@ -38,8 +42,153 @@ void SetLowEnergyDataCallback(BluetoothLowEnergy* manager, DataCallback callback
     manager->dataCallback = callback;
 }
 
+void SetLowEnergyWriteCallback(BluetoothLowEnergy* manager, WriteCallback callback) {
+    manager->writeCallback = callback;
+}
+
 void LowEnergyWrite(BluetoothLowEnergy* manager, const char* data, uint32_t length) {
+    LowEnergyWriteAsync(manager, data, length);
+}
+
+uint64_t LowEnergyWriteAsync(BluetoothLowEnergy* manager, const char* data, uint32_t length) {
+    uint64_t id = WriteQueue::nextId();
+    QByteArray buf(data, length);
+    Trace::mark(TraceDispatchPosted, manager, id, length);
     QMetaObject::invokeMethod(manager, [=]() {
-        manager->write(data, length);
+        Trace::mark(TraceDispatchRun, manager, id);
+        manager->enqueueWrite(id, buf);
+    }, Qt::QueuedConnection);
+    return id;
+}
+
+void SetLowEnergyProtocolVersion(BluetoothLowEnergy* manager, int version) {
+    manager->framer.setProtocolVersion(version);
+}
+
+void GetLowEnergyFramingStats(BluetoothLowEnergy* manager, FramingStats* stats) {
+    *stats = manager->framer.stats();
+}
+
+void SetLowEnergyWriteMode(BluetoothLowEnergy* manager, int mode) {
+    manager->preferredWriteMode = mode;
+}
+
+int GetLowEnergyWriteMode(BluetoothLowEnergy* manager) {
+    return manager->writeMode;
+}
+
+int GetLowEnergyMtu(BluetoothLowEnergy* manager) {
+    return manager->mtu;
+}
+
+void SetLowEnergyTransactCallback(BluetoothLowEnergy* manager, TransactCallback callback) {
+    manager->transactCallback = callback;
+}
+
+uint64_t LowEnergyTransact(BluetoothLowEnergy* manager, const char* data, uint32_t length, int responseType, int timeout) {
+    uint64_t id = WriteQueue::nextId();
+    QByteArray buf(data, length);
+    Trace::mark(TraceDispatchPosted, manager, id, length);
+    QMetaObject::invokeMethod(manager, [=]() {
+        Trace::mark(TraceDispatchRun, manager, id);
+        manager->transactor->enqueue(PendingTransaction { id, buf, responseType, timeout });
+    }, Qt::QueuedConnection);
+    return id;
+}
+
+void GetLowEnergyConnectionStats(BluetoothLowEnergy* manager, ConnectionStats* stats) {
+    *stats = manager->monitor.stats();
+}
+
+bool SetLowEnergyReceiveRing(BluetoothLowEnergy* manager, void* memory, uint32_t size, int mode) {
+    bool result = false;
+    QMetaObject::invokeMethod(manager, [=, &result]() {
+        if (memory) result = manager->ring.attach(memory, size, mode);
+        else manager->ring.detach();
     }, Qt::BlockingQueuedConnection);
+    return result;
+}
+
+void SetLowEnergyReceivedCallback(BluetoothLowEnergy* manager, GenericCallback callback) {
+    manager->receivedCallback = callback;
+}
+
+void LowEnergyReceiveRingConsumed(BluetoothLowEnergy* manager) {
+    QMetaObject::invokeMethod(manager, [=]() {
+        manager->resumeReceive();
+    }, Qt::QueuedConnection);
+}
+
+void GetLowEnergyReceiveRingStats(BluetoothLowEnergy* manager, ReceiveRingStats* stats) {
+    *stats = manager->ring.stats();
+}
+
+void SetLowEnergyReconnectPolicy(BluetoothLowEnergy* manager, const ReconnectPolicy* policy) {
+    ReconnectPolicy value = *policy;
+    QMetaObject::invokeMethod(manager, [=]() {
+        manager->setReconnectPolicy(value);
+    }, Qt::QueuedConnection);
+}
+
+void SetLowEnergyResumedCallback(BluetoothLowEnergy* manager, GenericCallback callback) {
+    manager->resumedCallback = callback;
+}
+
+int GetLowEnergyReconnectState(BluetoothLowEnergy* manager) {
+    return manager->supervisor->current();
+}
+
+uint64_t AddLowEnergyPoll(BluetoothLowEnergy* manager, uint8_t type, uint32_t interval, uint32_t jitter) {
+    uint64_t id = WriteQueue::nextId();
+    QMetaObject::invokeMethod(manager, [=]() {
+        manager->addPoll(id, type, interval, jitter);
+    }, Qt::QueuedConnection);
+    return id;
+}
+
+void RemoveLowEnergyPoll(BluetoothLowEnergy* manager, uint64_t id) {
+    QMetaObject::invokeMethod(manager, [=]() {
+        manager->removePoll(id);
+    }, Qt::QueuedConnection);
+}
+
+bool ReplayLowEnergyCapture(BluetoothLowEnergy* manager, const char* path, uint32_t source, double speed) {
+    bool result = false;
+    QString file = QString::fromUtf8(path);
+    QMetaObject::invokeMethod(manager, [=, &result]() {
+        result = manager->replay(file, source, speed);
+    }, Qt::BlockingQueuedConnection);
+    return result;
+}
+
+void StopLowEnergyReplay(BluetoothLowEnergy* manager) {
+    QMetaObject::invokeMethod(manager, [=]() {
+        manager->replayer->stop();
+    }, Qt::QueuedConnection);
+}
+
+bool IsLowEnergyReplaying(BluetoothLowEnergy* manager) {
+    return manager->replayer->running();
+}
+
+void SetLowEnergyStateMirror(BluetoothLowEnergy* manager, bool enabled, bool encrypted) {
+    manager->mirror.setEnabled(enabled, encrypted);
+}
+
+void SetLowEnergyStateChangedCallback(BluetoothLowEnergy* manager, StateCallback callback) {
+    manager->stateCallback = callback;
+}
+
+void GetLowEnergyDeviceSnapshot(BluetoothLowEnergy* manager, DeviceSnapshot* snapshot) {
+    *snapshot = manager->mirror.snapshot();
+}
+
+void SetLowEnergyLinkProfile(BluetoothLowEnergy* manager, int profile) {
+    QMetaObject::invokeMethod(manager, [=]() {
+        manager->setLinkProfile(profile);
+    }, Qt::QueuedConnection);
+}
+
+void GetLowEnergyLinkParameters(BluetoothLowEnergy* manager, LinkParameters* parameters) {
+    *parameters = manager->tuner->parameters();
 }
@@ -4,9 +4,28 @@
 #include <QLowEnergyController>
 #include <BluetoothAdapter.h>
 #include <ApplicationLoop.h>
+#include <FrameAssembler.h>
+#include <WriteQueue.h>
+#include <Transactor.h>
+#include <ConnectionMonitor.h>
+#include <Loopback.h>
+#include <EventQueue.h>
+#include <ReceiveRing.h>
+#include <Supervisor.h>
+#include <SessionGroup.h>
+#include <StateCache.h>
+#include <PollScheduler.h>
+#include <Capture.h>
+#include <Trace.h>
+#include <LinkTuner.h>
+#include <Codec.h>
 #include <QObject>
 #include <QDebug>
+#include <QTimer>
+#include <QQueue>
 #include <qthread.h>
+#include <atomic>
+#include <cstring>
 
 struct DeviceConnectInfo {
     const char* MacAddress;
@@ -19,25 +38,120 @@ typedef void (*GenericCallback)();
 typedef void (*DataCallback)(const char* data, uint32_t length);
 typedef void (*ErrorCallback)(const char* message, int code);
 
+enum LowEnergyWriteMode {
+    WriteModeAuto = 0,
+    WriteModeWithResponse = 1,
+    WriteModeWithoutResponse = 2
+};
+
 class BluetoothLowEnergy : public QObject {
     Q_OBJECT
 
+public:
+    BluetoothLowEnergy() {
+        pacer = new QTimer(this);
+        pacer->setSingleShot(true);
+        pacer->setInterval(PacingInterval);
+        connect(pacer, &QTimer::timeout, this, &BluetoothLowEnergy::onPacerElapsed);
+        transactor = new Transactor(this);
+        transactor->monitor = &monitor;
+        transactor->send = [this](uint64_t id, const QByteArray& data) {
+            enqueueWrite(id, data);
+        };
+        transactor->completed = [this](uint64_t id, int status, const char* data, uint32_t length) {
+            // polls only feed the mirror, the host never sees them complete
+            if (id == polling) {
+                polling = 0;
+                return;
+            }
+
+            if (SessionGroup::complete(id, status, data, length)) return;
+            notify(EventTransact, status, id, data, length);
+        };
+        writeHandler = [this](uint64_t id, int status) {
+            onWriteFinished(id, status);
+        };
+        supervisor = new Supervisor(this);
+        supervisor->retry = [this]() {
+            reconnect();
+        };
+        tuner = new LinkTuner(this);
+        tuner->request = [this](const QLowEnergyConnectionParameters& parameters) {
+            if (controller && controller->state() != QLowEnergyController::UnconnectedState)
+                controller->requestConnectionUpdate(parameters);
+        };
+        replayer = new CaptureReplay(this);
+        replayer->deliver = [this](const CaptureRecord& record, const char* data) {
+            if (record.Kind == CaptureFrame) {
+                onFrameReceived(data, record.Length);
+                return;
+            }
+
+            // error callbacks expect a terminated string
+            QByteArray buf(data, record.Length);
+            notify(static_cast<EventType>(record.Event), record.Code, 0, buf.constData(), buf.length());
+        };
+    }
+
+    ~BluetoothLowEnergy() {
+        delete device;
+    }
+
 public slots:
     void beginConnect(const char* localAddress, const char* macAddress, const char* serviceUuid, const char* writeUuid, const char* readUuid) {
         if (connected) return;
+        muted = false;
+        supervisor->start();
+        mirror.reset();
+        framer.reset();
+        monitor.begin();
+        delete this->device;
         this->device = new DeviceConnectInfo {
             macAddress, serviceUuid, writeUuid, readUuid
         };
         auto address = QString::fromUtf8(this->device->MacAddress);
-        controller = QLowEnergyController::createCentral(QBluetoothAddress(address), QBluetoothAddress(QString::fromUtf8(localAddress)), this);
-        connect(controller, &QLowEnergyController::connected, controller, &QLowEnergyController::discoverServices);
+        AdapterManager::instance()->release(localAdapter);
+        // an empty local address lets the least loaded adapter take the link
+        localAdapter = AdapterManager::instance()->select(QBluetoothAddress(QString::fromUtf8(localAddress)));
+        AdapterManager::instance()->acquire(localAdapter);
+        if (Loopback::enabled()) {
+            link = new VirtualLink(QBluetoothAddress(address), this);
+            connect(link, &VirtualLink::connected, this, &BluetoothLowEnergy::onLinkConnected);
+            connect(link, &VirtualLink::disconnected, this, &BluetoothLowEnergy::onLinkDisconnected);
+            connect(link, &VirtualLink::errorOccurred, this, &BluetoothLowEnergy::onLinkError);
+            connect(link, &QIODevice::readyRead, this, &BluetoothLowEnergy::onLinkDataReceived);
+            connect(link, &QIODevice::bytesWritten, this, [this]() {
+                // stands in for characteristicWritten, which only confirms acknowledged writes
+                if (writeMode == WriteModeWithResponse) onChunkWritten();
+            });
+            link->open(QIODevice::ReadWrite);
+            return;
+        }
+
+        controller = QLowEnergyController::createCentral(QBluetoothAddress(address), localAdapter, this);
+        connect(controller, &QLowEnergyController::connected, this, &BluetoothLowEnergy::onConnected);
+        connect(controller, &QLowEnergyController::disconnected, this, &BluetoothLowEnergy::onControllerDisconnected);
         connect(controller, QOverload<QLowEnergyController::Error>::of(&QLowEnergyController::error), this, &BluetoothLowEnergy::onErrorOccurred);
         connect(controller, &QLowEnergyController::serviceDiscovered, this, &BluetoothLowEnergy::onServiceDiscovered);
+        connect(controller, &QLowEnergyController::mtuChanged, this, &BluetoothLowEnergy::onMtuChanged);
+        connect(controller, &QLowEnergyController::connectionUpdated, this, &BluetoothLowEnergy::onConnectionUpdated);
         controller->connectToDevice();
     }
 
     void beginDisconnect() {
+        supervisor->stop();
+        replayer->stop();
+        tuner->stop();
         connected = false;
+        transactor->abort(WriteAborted);
+        writes.failAll(WriteAborted, writeHandler);
+        monitor.end();
+        stopPolls();
+        AdapterManager::instance()->release(localAdapter);
+        localAdapter = QBluetoothAddress();
+        pacer->stop();
+        sending.clear();
+        offset = 0;
         resetCallbacks();
         if (service) {
             if (readCharacteristic.isValid()) {
@@ -49,111 +163,554 @@ public slots:
             service = nullptr;
         }
 
+        writeCharacteristic = QLowEnergyCharacteristic();
+        readCharacteristic = QLowEnergyCharacteristic();
+        if (link) {
+            // cleared first, closing reports the disconnect back to us
+            auto old = link;
+            link = nullptr;
+            old->close();
+            old->deleteLater();
+        }
+
         if (controller) {
-            controller->disconnectFromDevice();
-            controller->deleteLater();
+            // same here, late disconnected signals are ignored once it's cleared
+            auto old = controller;
             controller = nullptr;
+            old->disconnectFromDevice();
+            old->deleteLater();
+        }
+    }
+
+    void enqueueWrite(uint64_t id, const QByteArray& data) {
+        if ((!service && !link) || !connected) {
+            onWriteFinished(id, WriteNotConnected);
+            return;
+        }
+
+        if (data.isEmpty()) {
+            onWriteFinished(id, WriteCompleted);
+            return;
         }
+
+        Trace::mark(TraceWriteEnqueued, this, id, data.length());
+        if (Capture::active()) Capture::instance()->record(this, CaptureWrite, 0, 0, data.constData(), data.length());
+        writes.enqueue(id, data);
+        // background polls must not keep the fast interval alive on an idle link
+        if (id != polling) tuner->activity();
+        sendNext();
+    }
+
+    void resumeReceive() {
+        // notifications can't be held back, only the backlog is moved over
+        bool wasEmpty;
+        ring.flush(&wasEmpty);
+        if (wasEmpty) notify(EventReceived);
     }
 
-    void write(const char* data, uint32_t length) {
-        auto buf = QByteArray::fromRawData(data, length);
-        service->writeCharacteristic(writeCharacteristic, buf);
+    void setReconnectPolicy(const ReconnectPolicy& policy) {
+        supervisor->setPolicy(policy);
+    }
+
+    // plays a capture into this connection as if the device sent it, only
+    // while no real link is up
+    bool replay(const QString& path, uint32_t source, double speed) {
+        if (connected) return false;
+        muted = false;
+        return replayer->start(path, source, speed);
+    }
+
+    void setLinkProfile(int profile) {
+        tuner->setProfile(profile);
+    }
+
+    void addPoll(uint64_t id, uint8_t type, uint32_t interval, uint32_t jitter) {
+        polls.append(id);
+        PollScheduler::current()->add(id, interval, jitter, [this, type, interval]() {
+            poll(type, interval);
+        });
+    }
+
+    void removePoll(uint64_t id) {
+        if (polls.removeOne(id)) PollScheduler::current()->remove(id);
     }
 
 private slots:
+    void onWriteFinished(uint64_t id, int status) {
+        // writes issued on behalf of a transaction are reported through it
+        if (transactor->owns(id)) {
+            transactor->writeFinished(id, status);
+            return;
+        }
+
+        notify(EventWrite, status, id);
+    }
+
+    void sendNext() {
+        if (!service && !link) return;
+        bool withoutResponse = writeMode == WriteModeWithoutResponse;
+        int chunkSize = qMax(DefaultMtu, mtu.load()) - 3;
+        while (credits > 0) {
+            if (!writes.hasInflight()) {
+                if (!writes.hasQueued()) return;
+                writes.takeNext();
+                offset = 0;
+            }
+
+            // remaining chunks of this write are still waiting for confirmation
+            const PendingWrite& write = writes.current();
+            if (offset >= write.data.length()) return;
+            QByteArray chunk = write.data.mid(offset, chunkSize);
+            offset += chunk.length();
+            credits--;
+            monitor.wrote(chunk.length());
+            if (withoutResponse) {
+                writeChunk(chunk, QLowEnergyService::WriteWithoutResponse);
+                writes.acknowledge(chunk.length(), writeHandler);
+                if (!writes.hasInflight()) offset = 0;
+            } else {
+                sending.enqueue(chunk.length());
+                writeChunk(chunk, QLowEnergyService::WriteWithResponse);
+            }
+        }
+
+        // nothing confirms unacknowledged writes, so the window is refilled
+        // on a timer unless the backend reports them as written
+        if (withoutResponse && !pacer->isActive()) pacer->start();
+    }
+
+    void writeChunk(const QByteArray& chunk, QLowEnergyService::WriteMode mode) {
+        Trace::mark(TraceSocketWrite, this, 0, chunk.length());
+        if (link) link->write(chunk);
+        else service->writeCharacteristic(writeCharacteristic, chunk, mode);
+    }
+
+    void onPacerElapsed() {
+        credits = writeWindow();
+        sendNext();
+    }
+
+    void onCharacteristicWritten(const QLowEnergyCharacteristic& characteristic, const QByteArray& value) {
+        Q_UNUSED(value);
+        if (characteristic.uuid() != writeCharacteristic.uuid()) return;
+        onChunkWritten();
+    }
+
+    void onChunkWritten() {
+        Trace::mark(TraceBytesWritten, this, 0, sending.isEmpty() ? 0 : sending.head());
+        credits = qMin(credits + 1, writeWindow());
+        if (!sending.isEmpty()) {
+            writes.acknowledge(sending.dequeue(), writeHandler);
+            if (!writes.hasInflight()) offset = 0;
+        }
+
+        sendNext();
+    }
+
+    void onServiceError(QLowEnergyService::ServiceError error) {
+        if (error == QLowEnergyService::CharacteristicWriteError && writes.hasInflight()) {
+            writes.failInflight(WriteFailed, writeHandler);
+            sending.clear();
+            offset = 0;
+            credits = writeWindow();
+            sendNext();
+            return;
+        }
+
+        onErrorOccurred();
+    }
+
+    void onDescriptorWritten(const QLowEnergyDescriptor& descriptor, const QByteArray& value) {
+        if (descriptor.type() != QBluetoothUuid::ClientCharacteristicConfiguration || value != QByteArray::fromHex("0100")) return;
+        if (connected) return;
+        // frames sent before the peripheral confirms the subscription can
+        // have their answers dropped, so the link is only ready from here
+        monitor.mark(PhaseNotificationsEnabled);
+        connected = true;
+        monitor.mark(PhaseReady);
+        tuner->start();
+        notify(supervisor->ready() ? EventResumed : EventConnected);
+    }
+
+    void onMtuChanged(int value) {
+        mtu = value;
+    }
+
+    void onConnectionUpdated(const QLowEnergyConnectionParameters& parameters) {
+        if (sender() != controller) return;
+        tuner->granted(parameters);
+    }
+
     void onErrorOccurred() {
-        if (errorCallback) errorCallback(controller->errorString().toLocal8Bit().data(), controller->error());
+        if (suspend()) return;
+        QByteArray message = controller->errorString().toLocal8Bit();
+        notifyError(message.constData(), controller->error());
         beginDisconnect();
     }
 
+    void onConnected() {
+        monitor.mark(PhaseLinkConnected);
+        controller->discoverServices();
+    }
+
     void onServiceDiscovered(const QBluetoothUuid& uuid) {
+        if (service) return;
         auto expectedUuid = QBluetoothUuid(QString::fromUtf8(device->ServiceUuid));
         if (uuid != expectedUuid) return;
-        service = controller->createServiceObject(uuid);
+        attachService(controller->createServiceObject(uuid));
+    }
+
+    void attachService(QLowEnergyService* value) {
+        monitor.mark(PhaseServiceFound);
+        service = value;
         connect(service, &QLowEnergyService::stateChanged, this, &BluetoothLowEnergy::onDetailsDiscovered);
         service->discoverDetails();
     }
 
+    void searchCharacteristics() {
+        auto writeUuid = QBluetoothUuid(QString::fromUtf8(device->WriteUuid));
+        auto readUuid = QBluetoothUuid(QString::fromUtf8(device->ReadUuid));
+        const QList<QLowEnergyCharacteristic> chars = service->characteristics();
+
+        for (auto ch : chars) {
+            if (ch.properties().testFlag(QLowEnergyCharacteristic::Notify) && ch.uuid() == readUuid)
+                readCharacteristic = ch;
+            if ((ch.properties() & (QLowEnergyCharacteristic::Write | QLowEnergyCharacteristic::WriteNoResponse)) && ch.uuid() == writeUuid)
+                writeCharacteristic = ch;
+        }
+    }
+
     void onDetailsDiscovered(QLowEnergyService::ServiceState state) {
         if (state == QLowEnergyService::ServiceDiscovered) {
-            auto writeUuid = QBluetoothUuid(QString::fromUtf8(device->WriteUuid));
-            auto readUuid = QBluetoothUuid(QString::fromUtf8(device->ReadUuid));
-            const QList<QLowEnergyCharacteristic> chars = service->characteristics();
-
-            for (auto ch : chars) {
-                if (ch.properties().testFlag(QLowEnergyCharacteristic::Notify) && ch.uuid() == readUuid)
-                    readCharacteristic = ch;
-                if (ch.properties().testFlag(QLowEnergyCharacteristic::Write) && ch.uuid() == writeUuid)
-                    writeCharacteristic = ch;
-            }
+            searchCharacteristics();
 
             if (readCharacteristic.isValid() && writeCharacteristic.isValid()) {
+                monitor.mark(PhaseDetailsDiscovered);
+                resolveWriteMode(writeCharacteristic.properties());
+                mtu = controller->mtu();
                 connect(service, &QLowEnergyService::stateChanged, this, &BluetoothLowEnergy::onServiceStateChanged);
-                connect(service, QOverload<QLowEnergyService::ServiceError>::of(&QLowEnergyService::error), this, &BluetoothLowEnergy::onErrorOccurred);
+                connect(service, QOverload<QLowEnergyService::ServiceError>::of(&QLowEnergyService::error), this, &BluetoothLowEnergy::onServiceError);
                 connect(service, &QLowEnergyService::characteristicChanged, this, &BluetoothLowEnergy::onDataReceived);
+                connect(service, &QLowEnergyService::characteristicWritten, this, &BluetoothLowEnergy::onCharacteristicWritten);
+                connect(service, &QLowEnergyService::descriptorWritten, this, &BluetoothLowEnergy::onDescriptorWritten);
                 QLowEnergyDescriptor desc = readCharacteristic.descriptor(QBluetoothUuid::ClientCharacteristicConfiguration);
                 service->writeDescriptor(desc, QByteArray::fromHex("0100")); // ENABLE_NOTIFICATION_VALUE
-                if (connectedCallback) connectedCallback();
-                connected = true;
                 return;
             }
 
-            if (errorCallback) errorCallback("Failed to find valid Rx/Tx characteristic", -3);
+            notifyError("Failed to find valid Rx/Tx characteristic", -3);
             beginDisconnect();
         }
 
         if (state == QLowEnergyService::InvalidService) {
-            if (errorCallback) errorCallback("Device no longer exists", -5);
+            if (suspend()) return;
+            notifyError("Device no longer exists", -5);
             beginDisconnect();
         }
     }
 
     void onDataReceived(const QLowEnergyCharacteristic &characteristic, const QByteArray &value) {
         Q_UNUSED(characteristic);
-        if (!dataCallback) return;
-        dataCallback(value.data(), value.length());
+        Trace::mark(TraceNotification, this, 0, value.length());
+        monitor.received(value.length());
+        // long frames may be split over several notifications
+        framer.feed(value.constData(), value.length(), [this](const char* data, uint32_t length) {
+            onFrameReceived(data, length);
+        });
+    }
+
+    void onFrameReceived(const char* data, uint32_t length) {
+        if (Capture::active()) Capture::instance()->record(this, CaptureFrame, 0, 0, data, length);
+        // the mirror sees every frame, answers to transactions included
+        if (mirror.enabled()) {
+            uint32_t changed = mirror.update(data, length);
+            if (changed) {
+                DeviceSnapshot snapshot = mirror.snapshot();
+                notify(EventStateChanged, changed, snapshot.Sequence, reinterpret_cast<const char*>(&snapshot), sizeof(snapshot));
+            }
+        }
+
+        if (transactor->consume(data, length)) return;
+        if (ring.attached()) {
+            bool wasEmpty;
+            ring.offer(data, length, &wasEmpty);
+            if (wasEmpty) notify(EventReceived);
+            return;
+        }
+
+        notify(EventData, 0, 0, data, length);
+    }
+
+    void onLinkConnected() {
+        // the virtual device has no GATT table, every phase completes at once
+        monitor.mark(PhaseLinkConnected);
+        monitor.mark(PhaseServiceFound);
+        monitor.mark(PhaseDetailsDiscovered);
+        monitor.mark(PhaseNotificationsEnabled);
+        resolveWriteMode(QLowEnergyCharacteristic::Write | QLowEnergyCharacteristic::WriteNoResponse);
+        mtu = Loopback::config().Mtu;
+        connected = true;
+        monitor.mark(PhaseReady);
+        notify(supervisor->ready() ? EventResumed : EventConnected);
+    }
+
+    void onLinkDisconnected() {
+        if (suspend()) return;
+        notify(EventDisconnected);
+        beginDisconnect();
+    }
+
+    void onControllerDisconnected() {
+        if (sender() != controller) return;
+        onLinkDisconnected();
+    }
+
+    void onLinkError(const QString& message) {
+        if (suspend()) return;
+        QByteArray buf = message.toLocal8Bit();
+        notifyError(buf.constData(), -1);
+        beginDisconnect();
+    }
+
+    void onLinkDataReceived() {
+        // hand the stream over in notification sized pieces
+        int size = qMax(DefaultMtu, mtu.load()) - 3;
+        while (link && link->bytesAvailable() > 0) {
+            QByteArray value = link->read(size);
+            if (value.isEmpty()) break;
+            onDataReceived(readCharacteristic, value);
+        }
     }
 
     void onServiceStateChanged(QLowEnergyService::ServiceState state) {
         if(state == QLowEnergyService::InvalidService) {
-            if (errorCallback) errorCallback("Invalid BLE service", -3);
+            if (suspend()) return;
+            notifyError("Invalid BLE service", -3);
             beginDisconnect();
         }
     }
 
+    void resolveWriteMode(QLowEnergyCharacteristic::PropertyTypes properties) {
+        bool withResponse = properties.testFlag(QLowEnergyCharacteristic::Write);
+        bool withoutResponse = properties.testFlag(QLowEnergyCharacteristic::WriteNoResponse);
+        int mode = preferredWriteMode;
+        if (mode == WriteModeAuto) mode = withoutResponse ? WriteModeWithoutResponse : WriteModeWithResponse;
+        if (mode == WriteModeWithoutResponse && !withoutResponse) mode = WriteModeWithResponse;
+        if (mode == WriteModeWithResponse && !withResponse) mode = WriteModeWithoutResponse;
+        writeMode = mode;
+        credits = writeWindow();
+        sending.clear();
+        offset = 0;
+    }
+
+    // a supervised link dropped: pending work fails and the service goes,
+    // the callbacks and the controller stay for the next attempt, which runs
+    // discoverServices and discoverDetails again and re-enables notifications
+    bool suspend() {
+        if (supervisor->waiting()) return true;
+        if (!supervisor->lost()) return false;
+        connected = false;
+        tuner->stop();
+        transactor->abort(WriteAborted);
+        writes.failAll(WriteAborted, writeHandler);
+        monitor.end();
+        pacer->stop();
+        sending.clear();
+        offset = 0;
+        if (service) {
+            service->deleteLater();
+            service = nullptr;
+        }
+
+        writeCharacteristic = QLowEnergyCharacteristic();
+        readCharacteristic = QLowEnergyCharacteristic();
+        if (link && link->isOpen()) link->close();
+        if (controller && controller->state() != QLowEnergyController::UnconnectedState)
+            controller->disconnectFromDevice();
+        return true;
+    }
+
+    void reconnect() {
+        framer.reset();
+        monitor.begin();
+        if (link) link->open(QIODevice::ReadWrite);
+        else if (controller) controller->connectToDevice();
+    }
+
+    int writeWindow() const {
+        return writeMode == WriteModeWithoutResponse ? NoResponseWindow : 1;
+    }
+
+    // one poll in flight per device, and none when a frame reported the
+    // field within the interval anyway
+    void poll(uint8_t type, uint32_t interval) {
+        if (!connected || polling) return;
+        uint32_t field = StateCache::field(type);
+        if (field && mirror.enabled()) {
+            int64_t age = mirror.age(field);
+            if (age >= 0 && age < interval) return;
+        }
+
+        int version = framer.protocolVersion();
+        if (!version) version = framer.detectedVersion();
+        uint8_t frame[8];
+        int32_t length = Codec::encode(version, mirror.encrypted(), type, nullptr, 0, frame, sizeof(frame));
+        if (length < 0) return;
+        polling = WriteQueue::nextId();
+        transactor->enqueue(PendingTransaction { polling, QByteArray(reinterpret_cast<char*>(frame), length), type, PollTimeout });
+    }
+
+    void stopPolls() {
+        for (uint64_t id : polls) PollScheduler::current()->remove(id);
+        polls.clear();
+    }
+
     void resetCallbacks() {
         disconnectedCallback = nullptr;
         connectedCallback = nullptr;
         errorCallback = nullptr;
         dataCallback = nullptr;
+        writeCallback = nullptr;
+        transactCallback = nullptr;
+        receivedCallback = nullptr;
+        resumedCallback = nullptr;
+        stateCallback = nullptr;
+        muted = true;
     }
 
 private:
+    // every event goes out here, into the event queue when the host enabled
+    // it and to the per-object callbacks otherwise
+    void notify(EventType type, int code = 0, uint64_t id = 0, const char* data = nullptr, uint32_t length = 0) {
+        if (Capture::active() && (type <= EventError || type == EventResumed))
+            Capture::instance()->record(this, CaptureEvent, type, code, data, length);
+        if (EventQueue::enabled()) {
+            if (!muted) EventQueue::instance()->push(type, this, code, id, data, length);
+            return;
+        }
+
+        Trace::mark(TraceCallbackEnter, this, id, type);
+        switch (type) {
+        case EventConnected:
+            if (connectedCallback) connectedCallback();
+            break;
+        case EventDisconnected:
+            if (disconnectedCallback) disconnectedCallback();
+            break;
+        case EventError:
+            if (errorCallback) errorCallback(data, code);
+            break;
+        case EventData:
+            if (dataCallback) dataCallback(data, length);
+            break;
+        case EventWrite:
+            if (writeCallback) writeCallback(id, code);
+            break;
+        case EventTransact:
+            if (transactCallback) transactCallback(id, code, data, length);
+            break;
+        case EventReceived:
+            if (receivedCallback) receivedCallback();
+            break;
+        case EventResumed:
+            if (resumedCallback) resumedCallback();
+            break;
+        case EventStateChanged:
+            if (stateCallback) stateCallback(code, reinterpret_cast<const DeviceSnapshot*>(data));
+            break;
+        default:
+            break;
+        }
+
+        Trace::mark(TraceCallbackExit, this, id, type);
+    }
+
+    void notifyError(const char* message, int code) {
+        notify(EventError, code, 0, message, static_cast<uint32_t>(strlen(message)));
+    }
+
     QLowEnergyCharacteristic writeCharacteristic;
     QLowEnergyCharacteristic readCharacteristic;
-    QLowEnergyController* controller;
-    QLowEnergyService* service;
-    DeviceConnectInfo* device;
-    BluetoothAdapter* adapter;
-    bool connected;
+    QLowEnergyController* controller = nullptr;
+    QLowEnergyService* service = nullptr;
+    VirtualLink* link = nullptr;
+    DeviceConnectInfo* device = nullptr;
+    QBluetoothAddress localAdapter;
+    bool connected = false;
+    bool muted = false;
+    static constexpr int DefaultMtu = 23;
+    static constexpr int NoResponseWindow = 4;
+    static constexpr int PacingInterval = 8;
+    static constexpr int PollTimeout = 1000;
+    WriteQueue writes;
+    WriteHandler writeHandler;
+    QQueue<qint64> sending;
+    QTimer* pacer;
+    int credits = 1;
+    int offset = 0;
+    QList<uint64_t> polls;
+    uint64_t polling = 0;
 
 public:
-    GenericCallback disconnectedCallback;
-    GenericCallback connectedCallback;
-    ErrorCallback errorCallback;
-    DataCallback dataCallback;
+    FrameAssembler framer;
+    ReceiveRing ring;
+    StateCache mirror;
+    ConnectionMonitor monitor { ConnectionLowEnergy };
+    Supervisor* supervisor;
+    CaptureReplay* replayer;
+    LinkTuner* tuner;
+    std::atomic<int> preferredWriteMode { WriteModeAuto };
+    std::atomic<int> writeMode { WriteModeWithResponse };
+    std::atomic<int> mtu { DefaultMtu };
+    GenericCallback disconnectedCallback = nullptr;
+    GenericCallback connectedCallback = nullptr;
+    ErrorCallback errorCallback = nullptr;
+    DataCallback dataCallback = nullptr;
+    WriteCallback writeCallback = nullptr;
+    TransactCallback transactCallback = nullptr;
+    GenericCallback receivedCallback = nullptr;
+    GenericCallback resumedCallback = nullptr;
+    StateCallback stateCallback = nullptr;
+    Transactor* transactor;
 };
 
 extern "C" {
 BluetoothLowEnergy* CreateBluetoothLowEnergy();
+void DestroyBluetoothLowEnergy(BluetoothLowEnergy* manager);
 void LowEnergyConnect(BluetoothLowEnergy* manager, const char* localAddress, const char* macAddress, const char* serviceUuid, const char* writeUuid, const char* readUuid);
 void LowEnergyDisconnect(BluetoothLowEnergy* manager);
 void SetLowEnergyDisconnectedCallback(BluetoothLowEnergy* manager, GenericCallback callback);
 void SetLowEnergyConnectedCallback(BluetoothLowEnergy* manager, GenericCallback callback);
 void SetLowEnergyErrorCallback(BluetoothLowEnergy* manager, ErrorCallback callback);
 void SetLowEnergyDataCallback(BluetoothLowEnergy* manager, DataCallback callback);
+void SetLowEnergyWriteCallback(BluetoothLowEnergy* manager, WriteCallback callback);
 void LowEnergyWrite(BluetoothLowEnergy* manager, const char* data, uint32_t length);
+void SetLowEnergyWriteMode(BluetoothLowEnergy* manager, int mode);
+int GetLowEnergyWriteMode(BluetoothLowEnergy* manager);
+int GetLowEnergyMtu(BluetoothLowEnergy* manager);
+uint64_t LowEnergyWriteAsync(BluetoothLowEnergy* manager, const char* data, uint32_t length);
+void SetLowEnergyTransactCallback(BluetoothLowEnergy* manager, TransactCallback callback);
+uint64_t LowEnergyTransact(BluetoothLowEnergy* manager, const char* data, uint32_t length, int responseType, int timeout);
+void SetLowEnergyProtocolVersion(BluetoothLowEnergy* manager, int version);
+void GetLowEnergyFramingStats(BluetoothLowEnergy* manager, FramingStats* stats);
+void GetLowEnergyConnectionStats(BluetoothLowEnergy* manager, ConnectionStats* stats);
+bool SetLowEnergyReceiveRing(BluetoothLowEnergy* manager, void* memory, uint32_t size, int mode);
+void SetLowEnergyReceivedCallback(BluetoothLowEnergy* manager, GenericCallback callback);
+void LowEnergyReceiveRingConsumed(BluetoothLowEnergy* manager);
+void GetLowEnergyReceiveRingStats(BluetoothLowEnergy* manager, ReceiveRingStats* stats);
+void SetLowEnergyReconnectPolicy(BluetoothLowEnergy* manager, const ReconnectPolicy* policy);
+void SetLowEnergyResumedCallback(BluetoothLowEnergy* manager, GenericCallback callback);
+int GetLowEnergyReconnectState(BluetoothLowEnergy* manager);
+uint64_t AddLowEnergyPoll(BluetoothLowEnergy* manager, uint8_t type, uint32_t interval, uint32_t jitter);
+void RemoveLowEnergyPoll(BluetoothLowEnergy* manager, uint64_t id);
+bool ReplayLowEnergyCapture(BluetoothLowEnergy* manager, const char* path, uint32_t source, double speed);
+void StopLowEnergyReplay(BluetoothLowEnergy* manager);
+bool IsLowEnergyReplaying(BluetoothLowEnergy* manager);
+void SetLowEnergyLinkProfile(BluetoothLowEnergy* manager, int profile);
+void GetLowEnergyLinkParameters(BluetoothLowEnergy* manager, LinkParameters* parameters);
+void SetLowEnergyStateMirror(BluetoothLowEnergy* manager, bool enabled, bool encrypted);
+void SetLowEnergyStateChangedCallback(BluetoothLowEnergy* manager, StateCallback callback);
+void GetLowEnergyDeviceSnapshot(BluetoothLowEnergy* manager, DeviceSnapshot* snapshot);
 }
 
 #endif // BLUETOOTHLOWENERGY_H
@@ -0,0 +1,206 @@
+#include "Capture.h"
+
+#include <QDateTime>
+#include <QThread>
+#include <cstring>
+
+std::atomic<bool> Capture::running { false };
+
+static uint32_t padded(uint32_t length) {
+    return (length + 7) & ~7u;
+}
+
+Capture* Capture::instance() {
+    static Capture capture;
+    return &capture;
+}
+
+bool Capture::start(const QString& path, uint32_t bufferSize) {
+    stop();
+    QMutexLocker locker(&mutex);
+    file.setFileName(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    CaptureHeader header {};
+    memcpy(header.Magic, Magic, sizeof(Magic));
+    header.Version = 1;
+    header.Started = QDateTime::currentMSecsSinceEpoch();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    if (!bufferSize) bufferSize = DefaultBufferSize;
+    for (QByteArray& buffer : buffers) buffer.resize(padded(bufferSize));
+    current = 0;
+    filled = 0;
+    stopping = false;
+    sources.clear();
+    clock.start();
+    flusher = QThread::create([this]() { flushLoop(); });
+    flusher->setObjectName(QStringLiteral("comhelper-capture"));
+    flusher->start();
+    running.store(true, std::memory_order_release);
+    return true;
+}
+
+void Capture::stop() {
+    running.store(false, std::memory_order_release);
+    {
+        QMutexLocker locker(&mutex);
+        if (!flusher) return;
+        stopping = true;
+        wake.wakeOne();
+    }
+
+    flusher->wait();
+    delete flusher;
+    QMutexLocker locker(&mutex);
+    flusher = nullptr;
+    file.close();
+}
+
+void Capture::record(const void* source, int kind, int event, int code, const char* data, uint32_t length) {
+    uint32_t need = sizeof(CaptureRecord) + padded(length);
+    QMutexLocker locker(&mutex);
+    if (!running.load(std::memory_order_relaxed)) return;
+    QByteArray& buffer = buffers[current];
+    if (filled + need > static_cast<uint32_t>(buffer.size())) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        wake.wakeOne();
+        return;
+    }
+
+    auto it = sources.find(source);
+    if (it == sources.end()) it = sources.insert(source, sources.size() + 1);
+    CaptureRecord record {
+        static_cast<uint64_t>(clock.nsecsElapsed()), it.value(),
+        static_cast<uint16_t>(kind), static_cast<uint16_t>(event), code, length
+    };
+
+    char* out = buffer.data() + filled;
+    memcpy(out, &record, sizeof(record));
+    if (length) memcpy(out + sizeof(record), data, length);
+    memset(out + sizeof(record) + length, 0, padded(length) - length);
+    filled += need;
+    records.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(length, std::memory_order_relaxed);
+    if (filled > buffer.size() / 2) wake.wakeOne();
+}
+
+CaptureStats Capture::stats() const {
+    return CaptureStats {
+        records.load(std::memory_order_relaxed),
+        bytes.load(std::memory_order_relaxed),
+        dropped.load(std::memory_order_relaxed)
+    };
+}
+
+void Capture::flushLoop() {
+    QMutexLocker locker(&mutex);
+    for (;;) {
+        if (!stopping && filled <= buffers[current].size() / 2)
+            wake.wait(&mutex, FlushInterval);
+        bool last = stopping;
+        // producers move to the other buffer while this one is written
+        const QByteArray& full = buffers[current];
+        int length = filled;
+        current ^= 1;
+        filled = 0;
+        locker.unlock();
+        if (length) {
+            file.write(full.constData(), length);
+            file.flush();
+        }
+
+        locker.relock();
+        if (last) return;
+    }
+}
+
+CaptureReplay::CaptureReplay(QObject* parent) : QObject(parent) {
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &CaptureReplay::step);
+}
+
+bool CaptureReplay::start(const QString& path, uint32_t source, double speed) {
+    stop();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    size = file.size();
+    map = size >= static_cast<qint64>(sizeof(CaptureHeader)) ? file.map(0, size) : nullptr;
+    if (!map || memcmp(map, Capture::Magic, sizeof(Capture::Magic)) != 0) {
+        stop();
+        return false;
+    }
+
+    offset = sizeof(CaptureHeader);
+    this->source = source;
+    this->speed = speed;
+    started = false;
+    active.store(true, std::memory_order_release);
+    timer->start(0);
+    return true;
+}
+
+void CaptureReplay::stop() {
+    timer->stop();
+    active.store(false, std::memory_order_release);
+    if (map) file.unmap(const_cast<uchar*>(map));
+    map = nullptr;
+    file.close();
+}
+
+const CaptureRecord* CaptureReplay::peek() {
+    while (offset + static_cast<qint64>(sizeof(CaptureRecord)) <= size) {
+        auto record = reinterpret_cast<const CaptureRecord*>(map + offset);
+        // a capture cut short by a crash ends in a partial record
+        if (offset + static_cast<qint64>(sizeof(CaptureRecord) + padded(record->Length)) > size) return nullptr;
+        if (record->Kind != CaptureWrite && (!source || record->Source == source)) return record;
+        offset += sizeof(CaptureRecord) + padded(record->Length);
+    }
+
+    return nullptr;
+}
+
+void CaptureReplay::step() {
+    for (int count = 0; count < BatchSize; count++) {
+        const CaptureRecord* record = peek();
+        if (!record) {
+            stop();
+            return;
+        }
+
+        if (!started) {
+            first = record->Timestamp;
+            started = true;
+            clock.start();
+        }
+
+        if (speed > 0) {
+            qint64 due = static_cast<qint64>((record->Timestamp - first) / speed);
+            qint64 wait = due - clock.nsecsElapsed();
+            if (wait > 0) {
+                timer->start(static_cast<int>(wait / 1000000));
+                return;
+            }
+        }
+
+        offset += sizeof(CaptureRecord) + padded(record->Length);
+        if (deliver) deliver(*record, reinterpret_cast<const char*>(record + 1));
+        // the callback may have stopped us
+        if (!map) return;
+    }
+
+    // give the connection's other work a turn between batches
+    timer->start(0);
+}
+
+bool StartCapture(const char* path, uint32_t bufferSize) {
+    return Capture::instance()->start(QString::fromUtf8(path), bufferSize);
+}
+
+void StopCapture() {
+    Capture::instance()->stop();
+}
+
+void GetCaptureStats(CaptureStats* stats) {
+    *stats = Capture::instance()->stats();
+}
@@ -0,0 +1,135 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QHash>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+
+enum CaptureKind {
+    // bytes the host handed to a connection
+    CaptureWrite = 1,
+    // a whole inbound frame
+    CaptureFrame = 2,
+    // connected, disconnected, resumed or error; Event holds the EventType
+    CaptureEvent = 3
+};
+
+// A capture file is this header followed by records, each a CaptureRecord
+// and Length bytes of payload padded to 8 bytes, so the file can be mapped
+// and walked in place. The file is only ever appended to.
+struct CaptureHeader {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t Reserved;
+    // milliseconds since the epoch when the capture started
+    uint64_t Started;
+};
+
+struct CaptureRecord {
+    // monotonic nanoseconds since the capture started
+    uint64_t Timestamp;
+    // connections are numbered from 1 in the order they first show up
+    uint32_t Source;
+    uint16_t Kind;
+    uint16_t Event;
+    int32_t Code;
+    uint32_t Length;
+};
+
+struct CaptureStats {
+    uint64_t Records;
+    uint64_t Bytes;
+    uint64_t Dropped;
+};
+
+// Records traffic and state changes of every connection into two buffers
+// allocated up front. Connections append to one while a background thread
+// writes the other out, records that find both full are dropped and counted.
+class Capture {
+public:
+    static constexpr uint32_t DefaultBufferSize = 1 << 20;
+    static constexpr int FlushInterval = 100;
+    static constexpr char Magic[8] = { 'C', 'H', 'C', 'A', 'P', 'T', 'R', '1' };
+
+    static Capture* instance();
+    static bool active() {
+        return running.load(std::memory_order_acquire);
+    }
+
+    bool start(const QString& path, uint32_t bufferSize);
+    void stop();
+    void record(const void* source, int kind, int event, int code, const char* data, uint32_t length);
+    CaptureStats stats() const;
+
+private:
+    void flushLoop();
+
+    static std::atomic<bool> running;
+    QMutex mutex;
+    QWaitCondition wake;
+    QByteArray buffers[2];
+    int current = 0;
+    int filled = 0;
+    bool stopping = false;
+    QFile file;
+    QThread* flusher = nullptr;
+    QElapsedTimer clock;
+    QHash<const void*, uint32_t> sources;
+    std::atomic<uint64_t> records { 0 };
+    std::atomic<uint64_t> bytes { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+};
+
+// Feeds a capture back into a connection on the connection's thread, at
+// the recorded pace scaled by speed or, with speed 0, as fast as the
+// connection takes it. Writes in the capture are skipped.
+class CaptureReplay : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int BatchSize = 256;
+
+    explicit CaptureReplay(QObject* parent = nullptr);
+
+    // source 0 replays every connection in the capture
+    bool start(const QString& path, uint32_t source, double speed);
+    void stop();
+    bool running() const {
+        return active.load(std::memory_order_acquire);
+    }
+
+    std::function<void(const CaptureRecord& record, const char* data)> deliver;
+
+private slots:
+    void step();
+
+private:
+    const CaptureRecord* peek();
+
+    QFile file;
+    const uchar* map = nullptr;
+    qint64 size = 0;
+    qint64 offset = 0;
+    uint32_t source = 0;
+    double speed = 1;
+    uint64_t first = 0;
+    bool started = false;
+    QTimer* timer;
+    QElapsedTimer clock;
+    std::atomic<bool> active { false };
+};
+
+extern "C" {
+bool StartCapture(const char* path, uint32_t bufferSize);
+void StopCapture();
+void GetCaptureStats(CaptureStats* stats);
+}
+
+#endif // CAPTURE_H
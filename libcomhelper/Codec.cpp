@@ -0,0 +1,156 @@
+#include "Codec.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+uint32_t Codec::sum(const uint8_t* data, size_t length) {
+    uint64_t total = 0;
+    size_t i = 0;
+#ifdef CODEC_SSE2
+    // psadbw against zero adds 8 bytes at a time into 64-bit lanes
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(block, zero));
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    total = lanes[0] + lanes[1];
+#else
+    // bytes are split into even and odd 16-bit lanes, 128 rounds can't overflow them
+    while (i + 8 <= length) {
+        uint64_t lanes = 0;
+        for (int round = 0; round < 128 && i + 8 <= length; round++, i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            lanes += (word & 0x00FF00FF00FF00FFull) + ((word >> 8) & 0x00FF00FF00FF00FFull);
+        }
+
+        total += (lanes & 0xFFFF) + ((lanes >> 16) & 0xFFFF) + ((lanes >> 32) & 0xFFFF) + (lanes >> 48);
+    }
+#endif
+    for (; i < length; i++)
+        total += data[i];
+    return static_cast<uint32_t>(total);
+}
+
+void Codec::scramble(uint8_t* data, size_t length) {
+    size_t i = 0;
+#ifdef CODEC_SSE2
+    const __m128i key = _mm_set1_epi8(static_cast<char>(Key));
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(block, key));
+    }
+#endif
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        word ^= 0xA5A5A5A5A5A5A5A5ull;
+        memcpy(data + i, &word, sizeof(word));
+    }
+
+    for (; i < length; i++)
+        data[i] ^= Key;
+}
+
+bool Codec::verify(const uint8_t* frame, uint32_t length, bool v2) {
+    if (v2) return frame[length - 1] == (sum(frame, length - 1) & 0xFF);
+    uint16_t value = static_cast<uint16_t>(8217 + sum(frame, length - 2));
+    return frame[length - 2] == (value >> 8) && frame[length - 1] == (value & 0xFF);
+}
+
+int32_t Codec::encodedSize(int version, uint32_t length) {
+    if (version <= 1) return length > 254 ? CodecPayloadTooLong : static_cast<int32_t>(length + 5);
+    return length > 0xFFFF ? CodecPayloadTooLong : static_cast<int32_t>(length + 6);
+}
+
+int32_t Codec::encode(int version, bool encrypted, uint8_t type, const uint8_t* payload, uint32_t length, uint8_t* out, uint32_t capacity) {
+    int32_t total = encodedSize(version, length);
+    if (total < 0) return total;
+    if (static_cast<uint32_t>(total) > capacity) return CodecBufferTooSmall;
+
+    bool v2 = version > 1;
+    uint32_t offset = v2 ? 5 : 3;
+    out[0] = 0xAA;
+    if (v2) {
+        out[1] = 0xEC;
+        out[2] = type;
+        out[3] = static_cast<uint8_t>(length >> 8);
+        out[4] = static_cast<uint8_t>(length & 0xFF);
+    } else {
+        out[1] = static_cast<uint8_t>(length + 1);
+        out[2] = type;
+    }
+
+    if (length) memcpy(out + offset, payload, length);
+    if (encrypted) scramble(out + offset, length);
+    if (v2) {
+        out[total - 1] = static_cast<uint8_t>(sum(out, total - 1));
+    } else {
+        uint16_t value = static_cast<uint16_t>(8217 + sum(out, total - 2));
+        out[total - 2] = static_cast<uint8_t>(value >> 8);
+        out[total - 1] = static_cast<uint8_t>(value & 0xFF);
+    }
+
+    return total;
+}
+
+int32_t Codec::decode(int version, bool encrypted, const uint8_t* frame, uint32_t length, uint8_t* type, uint8_t* payload, uint32_t capacity) {
+    if (length < 5) return CodecInvalidFrame;
+    if (frame[0] != 0xAA && frame[0] != 0xBB && frame[0] != 0xCC) return CodecInvalidFrame;
+
+    bool v2 = version == 2 || (version == 0 && frame[1] == 0xEC);
+    uint32_t offset;
+    uint32_t size;
+    if (v2) {
+        if (length < 6 || frame[1] != 0xEC) return CodecInvalidFrame;
+        offset = 5;
+        size = (frame[3] << 8) | frame[4];
+        if (length != size + 6) return CodecInvalidFrame;
+    } else {
+        if (frame[1] == 0 || length != frame[1] + 4u) return CodecInvalidFrame;
+        offset = 3;
+        size = frame[1] - 1;
+    }
+
+    if (!verify(frame, length, v2)) return CodecChecksumMismatch;
+    if (size > capacity) return CodecBufferTooSmall;
+    *type = frame[2];
+    if (size) memcpy(payload, frame + offset, size);
+    if (encrypted && v2) scramble(payload, size);
+    return static_cast<int32_t>(size);
+}
+
+int32_t GetEncodedSize(int version, uint32_t length) {
+    return Codec::encodedSize(version, length);
+}
+
+int32_t EncodeFrame(int version, bool encrypted, uint8_t type, const char* payload, uint32_t length, char* out, uint32_t capacity) {
+    return Codec::encode(version, encrypted, type, reinterpret_cast<const uint8_t*>(payload), length,
+        reinterpret_cast<uint8_t*>(out), capacity);
+}
+
+int32_t EncodeBatch(int version, bool encrypted, const CodecCommand* commands, uint32_t count, char* out, uint32_t capacity) {
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const CodecCommand& command = commands[i];
+        int32_t written = Codec::encode(version, encrypted, command.Type, reinterpret_cast<const uint8_t*>(command.Payload),
+            command.Length, reinterpret_cast<uint8_t*>(out) + offset, capacity - offset);
+        if (written < 0) return written;
+        offset += written;
+    }
+
+    return static_cast<int32_t>(offset);
+}
+
+int32_t DecodeFrame(int version, bool encrypted, const char* frame, uint32_t length, uint8_t* type, char* payload, uint32_t capacity) {
+    return Codec::decode(version, encrypted, reinterpret_cast<const uint8_t*>(frame), length, type,
+        reinterpret_cast<uint8_t*>(payload), capacity);
+}
@@ -0,0 +1,45 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum CodecStatus {
+    CodecBufferTooSmall = -1,
+    CodecInvalidFrame = -2,
+    CodecChecksumMismatch = -3,
+    CodecPayloadTooLong = -4
+};
+
+struct CodecCommand {
+    uint8_t Type;
+    const char* Payload;
+    uint32_t Length;
+};
+
+// Edifier frame encoding into caller buffers, nothing here allocates.
+// v1: AA/BB/CC, length, type, payload, 16-bit checksum (seed 8217)
+// v2: AA/BB/CC, EC, type, 16-bit length, payload, 8-bit checksum
+// Encoding scrambles the payload with 0xA5 when encrypted, decoding only
+// unscrambles v2 frames since v1 devices answer in the clear.
+class Codec {
+public:
+    static constexpr uint8_t Key = 0xA5;
+
+    static uint32_t sum(const uint8_t* data, size_t length);
+    static void scramble(uint8_t* data, size_t length);
+    static bool verify(const uint8_t* frame, uint32_t length, bool v2);
+
+    static int32_t encodedSize(int version, uint32_t length);
+    static int32_t encode(int version, bool encrypted, uint8_t type, const uint8_t* payload, uint32_t length, uint8_t* out, uint32_t capacity);
+    static int32_t decode(int version, bool encrypted, const uint8_t* frame, uint32_t length, uint8_t* type, uint8_t* payload, uint32_t capacity);
+};
+
+extern "C" {
+int32_t GetEncodedSize(int version, uint32_t length);
+int32_t EncodeFrame(int version, bool encrypted, uint8_t type, const char* payload, uint32_t length, char* out, uint32_t capacity);
+int32_t EncodeBatch(int version, bool encrypted, const CodecCommand* commands, uint32_t count, char* out, uint32_t capacity);
+int32_t DecodeFrame(int version, bool encrypted, const char* frame, uint32_t length, uint8_t* type, char* payload, uint32_t capacity);
+}
+
+#endif // CODEC_H
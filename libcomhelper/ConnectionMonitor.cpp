@@ -0,0 +1,133 @@
+#include "ConnectionMonitor.h"
+
+namespace {
+    struct Histogram {
+        std::atomic<uint64_t> buckets[HistogramBuckets] {};
+        std::atomic<uint64_t> count { 0 };
+        std::atomic<uint64_t> total { 0 };
+        std::atomic<uint64_t> max { 0 };
+
+        void record(uint64_t usecs) {
+            int bucket = 0;
+            while (bucket < HistogramBuckets - 1 && (usecs >> (bucket + 1)) != 0) bucket++;
+            buckets[bucket]++;
+            count++;
+            total += usecs;
+            raise(max, usecs);
+        }
+
+        void copy(LatencyHistogram* out) const {
+            for (int i = 0; i < HistogramBuckets; i++)
+                out->Buckets[i] = buckets[i];
+            out->Count = count;
+            out->Total = total;
+            out->Max = max;
+        }
+
+        void reset() {
+            for (auto& bucket : buckets) bucket = 0;
+            count = 0;
+            total = 0;
+            max = 0;
+        }
+
+        static void raise(std::atomic<uint64_t>& value, uint64_t sample) {
+            uint64_t current = value;
+            while (sample > current && !value.compare_exchange_weak(current, sample)) { }
+        }
+    };
+
+    struct Totals {
+        std::atomic<uint64_t> sessions[ConnectionKindCount] {};
+        std::atomic<uint64_t> failures[ConnectionKindCount] {};
+        Histogram connect[ConnectionKindCount];
+        Histogram roundTrip[ConnectionKindCount];
+    };
+
+    Totals totals;
+}
+
+void ConnectionMonitor::begin() {
+    for (auto& phase : phases) phase = 0;
+    writes = 0;
+    writtenBytes = 0;
+    receives = 0;
+    receivedBytes = 0;
+    roundTrips = 0;
+    roundTripTotal = 0;
+    roundTripMax = 0;
+    timer.start();
+    active = true;
+}
+
+void ConnectionMonitor::mark(ConnectionPhase phase) {
+    if (!active || phases[phase] != 0) return;
+    // a phase reached within the first microsecond still reads as reached
+    uint64_t usecs = qMax<uint64_t>(1, timer.nsecsElapsed() / 1000);
+    phases[phase] = usecs;
+    if (phase != PhaseReady) return;
+    totals.sessions[kind]++;
+    totals.connect[kind].record(usecs);
+}
+
+void ConnectionMonitor::end() {
+    if (!active) return;
+    active = false;
+    if (phases[PhaseReady] == 0) totals.failures[kind]++;
+}
+
+void ConnectionMonitor::wrote(uint64_t bytes) {
+    writes++;
+    writtenBytes += bytes;
+}
+
+void ConnectionMonitor::received(uint64_t bytes) {
+    receives++;
+    receivedBytes += bytes;
+}
+
+void ConnectionMonitor::roundTrip(uint64_t usecs) {
+    roundTrips++;
+    roundTripTotal += usecs;
+    Histogram::raise(roundTripMax, usecs);
+    totals.roundTrip[kind].record(usecs);
+}
+
+ConnectionStats ConnectionMonitor::stats() const {
+    ConnectionStats stats;
+    for (int i = 0; i < PhaseCount; i++)
+        stats.Phases[i] = phases[i];
+    stats.Writes = writes;
+    stats.WrittenBytes = writtenBytes;
+    stats.Receives = receives;
+    stats.ReceivedBytes = receivedBytes;
+    stats.RoundTrips = roundTrips;
+    stats.RoundTripTotal = roundTripTotal;
+    stats.RoundTripMax = roundTripMax;
+    return stats;
+}
+
+ConnectionSnapshot ConnectionMonitor::snapshot() {
+    ConnectionSnapshot snapshot;
+    for (int kind = 0; kind < ConnectionKindCount; kind++) {
+        snapshot.Sessions[kind] = totals.sessions[kind];
+        snapshot.Failures[kind] = totals.failures[kind];
+        totals.connect[kind].copy(&snapshot.Connect[kind]);
+        totals.roundTrip[kind].copy(&snapshot.RoundTrip[kind]);
+    }
+
+    return snapshot;
+}
+
+void GetConnectionSnapshot(ConnectionSnapshot* snapshot) {
+    *snapshot = ConnectionMonitor::snapshot();
+}
+
+void ResetConnectionSnapshot() {
+    for (int kind = 0; kind < ConnectionKindCount; kind++) {
+        totals.sessions[kind] = 0;
+        totals.failures[kind] = 0;
+        totals.connect[kind].reset();
+        totals.roundTrip[kind].reset();
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef CONNECTIONMONITOR_H
+#define CONNECTIONMONITOR_H
+
+#include <QElapsedTimer>
+#include <cstdint>
+#include <atomic>
+
+enum ConnectionKind {
+    ConnectionClassic = 0,
+    ConnectionLowEnergy = 1,
+    ConnectionKindCount
+};
+
+enum ConnectionPhase {
+    PhaseLinkConnected = 0,
+    PhaseServiceFound = 1,
+    PhaseDetailsDiscovered = 2,
+    PhaseNotificationsEnabled = 3,
+    PhaseReady = 4,
+    PhaseCount
+};
+
+// bucket i counts samples in [2^i, 2^(i+1)) microseconds
+static constexpr int HistogramBuckets = 32;
+
+struct LatencyHistogram {
+    uint64_t Buckets[HistogramBuckets];
+    uint64_t Count;
+    uint64_t Total;
+    uint64_t Max;
+};
+
+struct ConnectionStats {
+    // microseconds since the connect began, 0 until the phase is reached
+    uint64_t Phases[PhaseCount];
+    uint64_t Writes;
+    uint64_t WrittenBytes;
+    uint64_t Receives;
+    uint64_t ReceivedBytes;
+    uint64_t RoundTrips;
+    uint64_t RoundTripTotal;
+    uint64_t RoundTripMax;
+};
+
+struct ConnectionSnapshot {
+    uint64_t Sessions[ConnectionKindCount];
+    uint64_t Failures[ConnectionKindCount];
+    LatencyHistogram Connect[ConnectionKindCount];
+    LatencyHistogram RoundTrip[ConnectionKindCount];
+};
+
+// Per-session phase timestamps and traffic counters. Completed connects and
+// round trips also land in process-wide histograms per connection kind.
+class ConnectionMonitor {
+public:
+    explicit ConnectionMonitor(ConnectionKind kind) : kind(kind) { }
+
+    void begin();
+    void mark(ConnectionPhase phase);
+    void end();
+    void wrote(uint64_t bytes);
+    void received(uint64_t bytes);
+    void roundTrip(uint64_t usecs);
+
+    ConnectionStats stats() const;
+    static ConnectionSnapshot snapshot();
+
+private:
+    ConnectionKind kind;
+    QElapsedTimer timer;
+    bool active = false;
+    std::atomic<uint64_t> phases[PhaseCount] {};
+    std::atomic<uint64_t> writes { 0 };
+    std::atomic<uint64_t> writtenBytes { 0 };
+    std::atomic<uint64_t> receives { 0 };
+    std::atomic<uint64_t> receivedBytes { 0 };
+    std::atomic<uint64_t> roundTrips { 0 };
+    std::atomic<uint64_t> roundTripTotal { 0 };
+    std::atomic<uint64_t> roundTripMax { 0 };
+};
+
+extern "C" {
+void GetConnectionSnapshot(ConnectionSnapshot* snapshot);
+void ResetConnectionSnapshot();
+}
+
+#endif // CONNECTIONMONITOR_H
@@ -0,0 +1,105 @@
+#include "DeviceRegistry.h"
+
+uint64_t DeviceRegistry::update(uint64_t address, bool connected) {
+    uint32_t size = count.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    for (uint32_t i = 0; i < size; i++) {
+        if (slots[i].address.load(std::memory_order_relaxed) != address) continue;
+        slot = &slots[i];
+        break;
+    }
+
+    if (slot && (slot->state.load(std::memory_order_relaxed) & 1) == connected) return 0;
+    if (!slot && !connected) return 0;
+
+    uint64_t evicted = 0;
+    if (!slot && size < Capacity) {
+        slot = &slots[size];
+    } else if (!slot) {
+        // full, the oldest tombstone makes room and its history is gone
+        for (uint32_t i = 0; i < size; i++) {
+            uint64_t state = slots[i].state.load(std::memory_order_relaxed);
+            if (state & 1) continue;
+            if (!slot || state < slot->state.load(std::memory_order_relaxed)) slot = &slots[i];
+        }
+
+        if (!slot) return 0;
+        evicted = slot->state.load(std::memory_order_relaxed) >> 1;
+    }
+
+    uint64_t generation = current.load(std::memory_order_relaxed) + 1;
+    uint64_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->address.store(address, std::memory_order_relaxed);
+    slot->state.store(generation << 1 | (connected ? 1 : 0), std::memory_order_relaxed);
+    if (slot == &slots[size]) count.store(size + 1, std::memory_order_relaxed);
+    if (evicted) horizon.store(evicted, std::memory_order_relaxed);
+    current.store(generation, std::memory_order_relaxed);
+    sequence.store(seq + 2, std::memory_order_release);
+    return generation;
+}
+
+QList<uint64_t> DeviceRegistry::connectedAddresses() const {
+    QList<uint64_t> result;
+    uint32_t size = count.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < size; i++)
+        if (slots[i].state.load(std::memory_order_relaxed) & 1)
+            result.append(slots[i].address.load(std::memory_order_relaxed));
+    return result;
+}
+
+template<typename Read>
+void DeviceRegistry::read(Read&& body) const {
+    for (;;) {
+        uint64_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        body();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before) return;
+    }
+}
+
+uint32_t DeviceRegistry::snapshot(uint64_t* addresses, uint32_t max, uint64_t* generation) const {
+    uint32_t total;
+    read([&]() {
+        total = 0;
+        *generation = current.load(std::memory_order_relaxed);
+        uint32_t size = count.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < size; i++) {
+            if (!(slots[i].state.load(std::memory_order_relaxed) & 1)) continue;
+            if (total < max) addresses[total] = slots[i].address.load(std::memory_order_relaxed);
+            total++;
+        }
+    });
+
+    return total;
+}
+
+int32_t DeviceRegistry::changes(uint64_t since, RegistryChange* changes, uint32_t max, uint64_t* generation) const {
+    int32_t total;
+    read([&]() {
+        total = 0;
+        *generation = current.load(std::memory_order_relaxed);
+        if (since < horizon.load(std::memory_order_relaxed)) {
+            total = -1;
+            return;
+        }
+
+        uint32_t size = count.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < size; i++) {
+            uint64_t state = slots[i].state.load(std::memory_order_relaxed);
+            if (state >> 1 <= since) continue;
+            if (static_cast<uint32_t>(total) < max) {
+                changes[total] = RegistryChange {
+                    slots[i].address.load(std::memory_order_relaxed),
+                    state >> 1, static_cast<uint32_t>(state & 1), 0
+                };
+            }
+
+            total++;
+        }
+    });
+
+    return total;
+}
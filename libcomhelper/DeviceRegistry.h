@@ -0,0 +1,54 @@
+#ifndef DEVICEREGISTRY_H
+#define DEVICEREGISTRY_H
+
+#include <QList>
+#include <cstdint>
+#include <atomic>
+
+struct RegistryChange {
+    uint64_t Address;
+    uint64_t Generation;
+    uint32_t Connected;
+    uint32_t Reserved;
+};
+
+// Devices connected to the adapter, kept up to date from the adapter's
+// signals. Every change bumps the generation; disconnected devices stay
+// behind as tombstones so hosts can ask what changed since the generation
+// they last saw. Only the adapter's thread writes, readers on any thread
+// go through a seqlock and never block.
+class DeviceRegistry {
+public:
+    static constexpr uint32_t Capacity = 64;
+
+    // returns the new generation, 0 when nothing changed
+    uint64_t update(uint64_t address, bool connected);
+    QList<uint64_t> connectedAddresses() const;
+
+    uint64_t generation() const {
+        return current.load(std::memory_order_acquire);
+    }
+
+    // both return the total count and fill in at most max entries
+    uint32_t snapshot(uint64_t* addresses, uint32_t max, uint64_t* generation) const;
+    // -1 when since is older than the retained history, take a snapshot then
+    int32_t changes(uint64_t since, RegistryChange* changes, uint32_t max, uint64_t* generation) const;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> address { 0 };
+        // generation << 1 | connected
+        std::atomic<uint64_t> state { 0 };
+    };
+
+    template<typename Read>
+    void read(Read&& body) const;
+
+    std::atomic<uint64_t> sequence { 0 };
+    std::atomic<uint64_t> current { 0 };
+    std::atomic<uint64_t> horizon { 0 };
+    std::atomic<uint32_t> count { 0 };
+    Slot slots[Capacity];
+};
+
+#endif // DEVICEREGISTRY_H
@@ -0,0 +1,200 @@
+#include "EventQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+#endif
+
+std::atomic<bool> EventQueue::active { false };
+
+EventQueue* EventQueue::instance() {
+    static EventQueue queue;
+    return &queue;
+}
+
+bool EventQueue::enable(uint32_t capacity) {
+    if (cells) {
+        // the ring is sized once, it may be in use by producers already
+        active.store(true, std::memory_order_release);
+        return true;
+    }
+
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0) return false;
+    if (!open()) return false;
+    cells = new Cell[capacity];
+    for (uint32_t i = 0; i < capacity; i++)
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    mask = capacity - 1;
+    active.store(true, std::memory_order_release);
+    return true;
+}
+
+void EventQueue::disable() {
+    active.store(false, std::memory_order_release);
+}
+
+bool EventQueue::push(uint32_t type, const void* source, int32_t code, uint64_t id, const char* data, uint32_t length, uint32_t flags) {
+    if (!cells) return false;
+    Cell* cell;
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &cells[pos & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    Event& event = cell->event;
+    uint32_t count = std::min(length, EventPayloadSize);
+    event.Type = type;
+    event.Flags = flags | (count < length ? EventTruncated : 0);
+    event.Code = code;
+    event.Length = count;
+    event.Source = reinterpret_cast<uintptr_t>(source);
+    event.Id = id;
+    if (count) memcpy(event.Payload, data, count);
+    if (count < length) truncated.fetch_add(1, std::memory_order_relaxed);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    pushed.fetch_add(1, std::memory_order_relaxed);
+    signal();
+    return true;
+}
+
+uint32_t EventQueue::drain(Event* events, uint32_t max) {
+    if (!cells) return 0;
+    // cleared before popping so a push racing with us signals again
+    clear();
+    uint32_t count = 0;
+    while (count < max) {
+        Cell& cell = cells[dequeuePos & mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (sequence != dequeuePos + 1) break;
+        events[count++] = cell.event;
+        cell.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+        dequeuePos++;
+    }
+
+    // the caller stopped early or a push slipped in after the handle was
+    // cleared, keep the handle readable for the rest
+    if (cells[dequeuePos & mask].sequence.load(std::memory_order_acquire) == dequeuePos + 1)
+        signal();
+    return count;
+}
+
+uint32_t EventQueue::wait(Event* events, uint32_t max, int timeout) {
+    uint32_t count = drain(events, max);
+    if (count || !cells) return count;
+#if defined(_WIN32)
+    WaitForSingleObject(reinterpret_cast<HANDLE>(readHandle), timeout < 0 ? INFINITE : timeout);
+#else
+    pollfd fd { static_cast<int>(readHandle), POLLIN, 0 };
+    poll(&fd, 1, timeout);
+#endif
+    return drain(events, max);
+}
+
+intptr_t EventQueue::handle() const {
+    return readHandle;
+}
+
+EventQueueStats EventQueue::stats() const {
+    return EventQueueStats {
+        pushed.load(std::memory_order_relaxed),
+        dropped.load(std::memory_order_relaxed),
+        truncated.load(std::memory_order_relaxed)
+    };
+}
+
+bool EventQueue::open() {
+#if defined(_WIN32)
+    HANDLE event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!event) return false;
+    readHandle = writeHandle = reinterpret_cast<intptr_t>(event);
+#elif defined(__linux__)
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0) return false;
+    readHandle = writeHandle = fd;
+#else
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    for (int fd : fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    readHandle = fds[0];
+    writeHandle = fds[1];
+#endif
+    return true;
+}
+
+void EventQueue::signal() {
+    // only the empty to non-empty transition costs a syscall
+    if (signaled.exchange(true, std::memory_order_seq_cst)) return;
+#if defined(_WIN32)
+    SetEvent(reinterpret_cast<HANDLE>(writeHandle));
+#elif defined(__linux__)
+    uint64_t one = 1;
+    ssize_t written = write(static_cast<int>(writeHandle), &one, sizeof(one));
+    (void)written;
+#else
+    char one = 1;
+    ssize_t written = write(static_cast<int>(writeHandle), &one, sizeof(one));
+    (void)written;
+#endif
+}
+
+void EventQueue::clear() {
+    // the handle goes first: a producer that signals in between finds the
+    // flag still set and skips, but its event is popped by the caller
+#if defined(_WIN32)
+    ResetEvent(reinterpret_cast<HANDLE>(readHandle));
+#else
+    char buf[64];
+    while (read(static_cast<int>(readHandle), buf, sizeof(buf)) > 0) { }
+#endif
+    signaled.store(false, std::memory_order_seq_cst);
+    // pairs with the exchange in signal(), either the pops see the event or
+    // its producer sees the cleared flag
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+bool EnableEventQueue(uint32_t capacity) {
+    return EventQueue::instance()->enable(capacity);
+}
+
+void DisableEventQueue() {
+    EventQueue::instance()->disable();
+}
+
+intptr_t GetEventQueueHandle() {
+    return EventQueue::instance()->handle();
+}
+
+uint32_t DrainEvents(Event* events, uint32_t max) {
+    return EventQueue::instance()->drain(events, max);
+}
+
+uint32_t WaitEvents(Event* events, uint32_t max, int timeout) {
+    return EventQueue::instance()->wait(events, max, timeout);
+}
+
+void GetEventQueueStats(EventQueueStats* stats) {
+    *stats = EventQueue::instance()->stats();
+}
@@ -0,0 +1,116 @@
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+enum EventType {
+    EventConnected = 1,
+    EventDisconnected = 2,
+    EventError = 3,
+    EventData = 4,
+    EventWrite = 5,
+    EventTransact = 6,
+    EventDiscovered = 7,
+    EventDiscoveryFinished = 8,
+    EventAdapterEnabled = 9,
+    EventAdapterDisabled = 10,
+    EventReceived = 11,
+    EventConnectedChanged = 12,
+    EventResumed = 13,
+    EventGroupCompleted = 14,
+    EventStateChanged = 15
+};
+
+enum EventFlag {
+    EventTruncated = 1
+};
+
+static constexpr uint32_t EventPayloadSize = 480;
+// group completed events keep the index of their first member up here
+static constexpr uint32_t EventGroupOffsetShift = 16;
+
+// Code carries the error code or write/transaction status, Id the write or
+// transaction id. Error, data, transact and adapter events copy their bytes
+// into Payload, received events only say the receive ring has frames.
+// Connected changed events carry the address, Code 1 for connected and the
+// registry generation in Id. Group completed events have the member count in
+// Code and a 16 byte record per member: pointer, status, response length;
+// groups with more members than fit come as several events with the same Id,
+// the first member of each at Flags >> EventGroupOffsetShift.
+// State changed events carry the changed fields in Code, the snapshot
+// sequence in Id and the DeviceSnapshot as payload.
+// Discovered events pack the device as NUL terminated name, address and
+// service uuids, an empty string, then the manufacturer data; Code is 1 for
+// LE devices and Id holds manufacturer id | major << 16 | minor << 32.
+struct Event {
+    uint32_t Type;
+    uint32_t Flags;
+    int32_t Code;
+    uint32_t Length;
+    uint64_t Source;
+    uint64_t Id;
+    char Payload[EventPayloadSize];
+};
+
+struct EventQueueStats {
+    uint64_t Pushed;
+    uint64_t Dropped;
+    uint64_t Truncated;
+};
+
+// Opt-in replacement for the per-event callbacks. Events from every object
+// go into one bounded lock-free MPSC queue and a single pollable handle
+// (eventfd, a pipe or a Win32 event) is signalled when it becomes non-empty.
+// When the queue is full new events are dropped and counted.
+class EventQueue {
+public:
+    static EventQueue* instance();
+    static bool enabled() {
+        return active.load(std::memory_order_acquire);
+    }
+
+    bool enable(uint32_t capacity);
+    void disable();
+
+    bool push(uint32_t type, const void* source, int32_t code = 0, uint64_t id = 0, const char* data = nullptr, uint32_t length = 0, uint32_t flags = 0);
+    uint32_t drain(Event* events, uint32_t max);
+    uint32_t wait(Event* events, uint32_t max, int timeout);
+    intptr_t handle() const;
+    EventQueueStats stats() const;
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Event event;
+    };
+
+    EventQueue() = default;
+    bool open();
+    void signal();
+    void clear();
+
+    static std::atomic<bool> active;
+    Cell* cells = nullptr;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> enqueuePos { 0 };
+    alignas(64) size_t dequeuePos = 0;
+    std::atomic<bool> signaled { false };
+    std::atomic<uint64_t> pushed { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+    std::atomic<uint64_t> truncated { 0 };
+    intptr_t readHandle = -1;
+    intptr_t writeHandle = -1;
+};
+
+extern "C" {
+bool EnableEventQueue(uint32_t capacity);
+void DisableEventQueue();
+intptr_t GetEventQueueHandle();
+uint32_t DrainEvents(Event* events, uint32_t max);
+uint32_t WaitEvents(Event* events, uint32_t max, int timeout);
+void GetEventQueueStats(EventQueueStats* stats);
+}
+
+#endif // EVENTQUEUE_H
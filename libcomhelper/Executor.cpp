@@ -0,0 +1,103 @@
+#include "Executor.h"
+
+#include <QMutexLocker>
+
+Executor::Executor() {
+    maxThreads = qBound(2, QThread::idealThreadCount(), 4);
+}
+
+Executor* Executor::instance() {
+    static Executor executor;
+    return &executor;
+}
+
+bool Executor::setThreadCount(int count) {
+    QMutexLocker locker(&mutex);
+    if (count < 1 || count < threads.length()) return false;
+    maxThreads = count;
+    return true;
+}
+
+int Executor::threadCount() {
+    QMutexLocker locker(&mutex);
+    return maxThreads;
+}
+
+int Executor::activeThreads() {
+    QMutexLocker locker(&mutex);
+    return threads.length();
+}
+
+void Executor::prestart(int count) {
+    QMutexLocker locker(&mutex);
+    while (threads.length() < qMin(count, maxThreads))
+        startThread(threads.length());
+}
+
+QThread* Executor::startThread(int index) {
+    QThread* thread = new QThread();
+    thread->setObjectName(QStringLiteral("comhelper-worker-%1").arg(index));
+    thread->start();
+    threads.append(thread);
+    load.append(0);
+    return thread;
+}
+
+QThread* Executor::attach(QObject* obj) {
+    QMutexLocker locker(&mutex);
+    // least loaded worker, round-robin between equally loaded ones
+    int index = -1;
+    for (int i = 0; i < threads.length(); i++) {
+        int candidate = (cursor + i) % threads.length();
+        if (index == -1 || load[candidate] < load[index]) index = candidate;
+    }
+
+    // spin up another worker before doubling up on a busy one
+    if ((index == -1 || load[index] > 0) && threads.length() < maxThreads) {
+        index = threads.length();
+        startThread(index);
+    }
+
+    cursor = (index + 1) % threads.length();
+
+    load[index]++;
+    pinned.insert(obj, index);
+    obj->moveToThread(threads[index]);
+    return threads[index];
+}
+
+void Executor::destroy(QObject* obj, const std::function<void()>& teardown) {
+    if (!obj) return;
+    auto run = [obj, teardown]() {
+        if (teardown) teardown();
+        obj->deleteLater();
+    };
+
+    // callbacks are allowed to destroy their own object, in which case
+    // blocking on the worker thread would deadlock
+    QThread* thread = obj->thread();
+    if (QThread::currentThread() == thread) run();
+    else if (thread && thread->isRunning()) QMetaObject::invokeMethod(obj, run, Qt::BlockingQueuedConnection);
+    else {
+        if (teardown) teardown();
+        delete obj;
+    }
+
+    QMutexLocker locker(&mutex);
+    auto it = pinned.find(obj);
+    if (it == pinned.end()) return;
+    load[it.value()]--;
+    pinned.erase(it);
+}
+
+bool SetExecutorThreadCount(int count) {
+    return Executor::instance()->setThreadCount(count);
+}
+
+int GetExecutorThreadCount() {
+    return Executor::instance()->threadCount();
+}
+
+int GetExecutorActiveThreads() {
+    return Executor::instance()->activeThreads();
+}
@@ -0,0 +1,45 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+#include <QHash>
+#include <functional>
+
+// Fixed pool of worker threads every libcomhelper object is pinned to.
+// Objects used to get their own QThread that was never stopped, which
+// leaked a thread per reconnect.
+class Executor {
+public:
+    static Executor* instance();
+
+    bool setThreadCount(int count);
+    int threadCount();
+    int activeThreads();
+    // starts workers ahead of the objects that will land on them
+    void prestart(int count);
+
+    QThread* attach(QObject* obj);
+    void destroy(QObject* obj, const std::function<void()>& teardown = nullptr);
+
+private:
+    Executor();
+    QThread* startThread(int index);
+
+    QMutex mutex;
+    QVector<QThread*> threads;
+    QVector<int> load;
+    QHash<QObject*, int> pinned;
+    int maxThreads;
+    int cursor = 0;
+};
+
+extern "C" {
+bool SetExecutorThreadCount(int count);
+int GetExecutorThreadCount();
+int GetExecutorActiveThreads();
+}
+
+#endif // EXECUTOR_H
@@ -0,0 +1,129 @@
+#include "FrameAssembler.h"
+
+#include <Codec.h>
+#include <algorithm>
+#include <cstring>
+
+void FrameAssembler::setProtocolVersion(int version) {
+    this->version = version;
+}
+
+int FrameAssembler::protocolVersion() const {
+    return version;
+}
+
+int FrameAssembler::detectedVersion() const {
+    return detected.load(std::memory_order_relaxed);
+}
+
+char* FrameAssembler::reserve(uint32_t* available) {
+    uint32_t tail = (head + size) % Capacity;
+    *available = tail >= head && size != Capacity
+        ? Capacity - tail : Capacity - size;
+    return reinterpret_cast<char*>(ring + tail);
+}
+
+void FrameAssembler::commit(uint32_t length, const FrameHandler& handler) {
+    size += length;
+    parse(handler);
+}
+
+void FrameAssembler::feed(const char* data, uint32_t length, const FrameHandler& handler) {
+    while (length > 0) {
+        uint32_t available;
+        char* buf = reserve(&available);
+        uint32_t count = std::min(length, available);
+        memcpy(buf, data, count);
+        commit(count, handler);
+        data += count;
+        length -= count;
+    }
+}
+
+void FrameAssembler::reset() {
+    head = 0;
+    size = 0;
+    syncing = false;
+}
+
+FramingStats FrameAssembler::stats() const {
+    return FramingStats {
+        frames.load(std::memory_order_relaxed),
+        droppedBytes.load(std::memory_order_relaxed),
+        checksumErrors.load(std::memory_order_relaxed),
+        resyncs.load(std::memory_order_relaxed)
+    };
+}
+
+void FrameAssembler::parse(const FrameHandler& handler) {
+    while (size >= 2) {
+        uint8_t header = at(0);
+        if (header != 0xBB && header != 0xCC) {
+            skip();
+            continue;
+        }
+
+        int expected = version;
+        bool v2 = expected == 2 || (expected == 0 && at(1) == 0xEC);
+        uint32_t length;
+        if (v2) {
+            if (size < 5) return;
+            if (at(1) != 0xEC) {
+                skip();
+                continue;
+            }
+
+            length = ((at(3) << 8) | at(4)) + 6;
+        } else {
+            // a v1 frame carries at least the type byte
+            if (at(1) == 0) {
+                skip();
+                continue;
+            }
+
+            length = at(1) + 4;
+        }
+
+        if (length > Capacity) {
+            skip();
+            continue;
+        }
+
+        if (size < length) return;
+        const uint8_t* frame = ring + head;
+        if (head + length > Capacity) {
+            uint32_t first = Capacity - head;
+            memcpy(scratch, ring + head, first);
+            memcpy(scratch + first, ring, length - first);
+            frame = scratch;
+        }
+
+        if (!Codec::verify(frame, length, v2)) {
+            checksumErrors.fetch_add(1, std::memory_order_relaxed);
+            skip();
+            continue;
+        }
+
+        syncing = false;
+        detected.store(v2 ? 2 : 1, std::memory_order_relaxed);
+        frames.fetch_add(1, std::memory_order_relaxed);
+        handler(reinterpret_cast<const char*>(frame), length);
+        discard(length);
+    }
+}
+
+void FrameAssembler::discard(uint32_t length) {
+    head = (head + length) % Capacity;
+    size -= length;
+    if (size == 0) head = 0;
+}
+
+void FrameAssembler::skip() {
+    if (!syncing) {
+        resyncs.fetch_add(1, std::memory_order_relaxed);
+        syncing = true;
+    }
+
+    droppedBytes.fetch_add(1, std::memory_order_relaxed);
+    discard(1);
+}
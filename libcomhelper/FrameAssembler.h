@@ -0,0 +1,59 @@
+#ifndef FRAMEASSEMBLER_H
+#define FRAMEASSEMBLER_H
+
+#include <functional>
+#include <cstdint>
+#include <atomic>
+
+struct FramingStats {
+    uint64_t Frames;
+    uint64_t DroppedBytes;
+    uint64_t ChecksumErrors;
+    uint64_t Resyncs;
+};
+
+typedef std::function<void(const char* data, uint32_t length)> FrameHandler;
+
+// Reassembles inbound Edifier frames from an arbitrarily chunked byte stream.
+// v1: BB/CC, length, type, payload, 16-bit checksum (seed 8217)
+// v2: BB/CC, EC, type, 16-bit length, payload, 8-bit checksum
+class FrameAssembler {
+public:
+    static constexpr uint32_t Capacity = 4096;
+
+    // 0 picks the layout per frame based on the EC app code
+    void setProtocolVersion(int version);
+    int protocolVersion() const;
+    // layout of the last good frame, v1 until one arrived
+    int detectedVersion() const;
+
+    char* reserve(uint32_t* available);
+    void commit(uint32_t length, const FrameHandler& handler);
+    void feed(const char* data, uint32_t length, const FrameHandler& handler);
+    void reset();
+
+    FramingStats stats() const;
+
+private:
+    uint8_t at(uint32_t offset) const {
+        return ring[(head + offset) % Capacity];
+    }
+
+    void parse(const FrameHandler& handler);
+    void discard(uint32_t length);
+    void skip();
+
+    uint8_t ring[Capacity];
+    uint8_t scratch[Capacity];
+    uint32_t head = 0;
+    uint32_t size = 0;
+    bool syncing = false;
+    std::atomic<int> version { 0 };
+    std::atomic<int> detected { 1 };
+    std::atomic<uint64_t> frames { 0 };
+    std::atomic<uint64_t> droppedBytes { 0 };
+    std::atomic<uint64_t> checksumErrors { 0 };
+    std::atomic<uint64_t> resyncs { 0 };
+};
+
+#endif // FRAMEASSEMBLER_H
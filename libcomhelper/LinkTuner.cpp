@@ -0,0 +1,85 @@
+#include "LinkTuner.h"
+
+LinkTuner::LinkTuner(QObject* parent) : QObject(parent) {
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &LinkTuner::onQuiet);
+}
+
+void LinkTuner::setProfile(int profile) {
+    if (profile < LinkProfileAuto || profile > LinkProfileIdle) return;
+    chosen = profile;
+    if (running) start();
+}
+
+void LinkTuner::start() {
+    running = true;
+    timer->stop();
+    if (chosen != LinkProfileAuto) {
+        apply(chosen);
+        return;
+    }
+
+    apply(LinkProfileBalanced);
+    timer->start(IdlePeriod);
+}
+
+void LinkTuner::stop() {
+    running = false;
+    timer->stop();
+    requested = 0;
+    interval = 0;
+    latency = 0;
+    timeout = 0;
+}
+
+void LinkTuner::granted(const QLowEnergyConnectionParameters& parameters) {
+    interval = static_cast<int32_t>(parameters.minimumInterval() * 1000);
+    latency = parameters.latency();
+    timeout = parameters.supervisionTimeout();
+}
+
+LinkParameters LinkTuner::parameters() const {
+    return LinkParameters {
+        interval.load(std::memory_order_relaxed) / 1000.0,
+        latency.load(std::memory_order_relaxed),
+        timeout.load(std::memory_order_relaxed),
+        requested.load(std::memory_order_relaxed)
+    };
+}
+
+void LinkTuner::onQuiet() {
+    if (!running || chosen != LinkProfileAuto) return;
+    if (requested == LinkProfileInteractive) {
+        apply(LinkProfileBalanced);
+        timer->start(IdlePeriod - QuietPeriod);
+    } else {
+        apply(LinkProfileIdle);
+    }
+}
+
+void LinkTuner::apply(int profile) {
+    if (requested == profile) return;
+    requested = profile;
+    // supervision timeouts stay above (1 + latency) * max interval * 2
+    QLowEnergyConnectionParameters parameters;
+    switch (profile) {
+    case LinkProfileInteractive:
+        parameters.setIntervalRange(7.5, 15);
+        parameters.setLatency(0);
+        parameters.setSupervisionTimeout(2000);
+        break;
+    case LinkProfileBalanced:
+        parameters.setIntervalRange(30, 50);
+        parameters.setLatency(0);
+        parameters.setSupervisionTimeout(4000);
+        break;
+    default:
+        parameters.setIntervalRange(200, 400);
+        parameters.setLatency(4);
+        parameters.setSupervisionTimeout(6000);
+        break;
+    }
+
+    if (request) request(parameters);
+}
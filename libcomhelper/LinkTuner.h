@@ -0,0 +1,73 @@
+#ifndef LINKTUNER_H
+#define LINKTUNER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QLowEnergyConnectionParameters>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+
+enum LinkProfile {
+    // interactive while commands go out, balanced after a quiet period
+    // and idle after a long one
+    LinkProfileAuto = 0,
+    LinkProfileInteractive = 1,
+    LinkProfileBalanced = 2,
+    LinkProfileIdle = 3
+};
+
+// what the central stack granted, all 0 until it reported an update
+struct LinkParameters {
+    double Interval;
+    int32_t Latency;
+    int32_t SupervisionTimeout;
+    // the profile last requested
+    int32_t Profile;
+};
+
+// Picks the LE connection parameters for a link. Short intervals make
+// volume and ANC changes feel immediate but keep the radio busy, a
+// monitored headset that isn't being touched is better off on long ones.
+class LinkTuner : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int QuietPeriod = 2000;
+    static constexpr int IdlePeriod = 30000;
+
+    explicit LinkTuner(QObject* parent = nullptr);
+
+    void setProfile(int profile);
+    // the link is ready for parameter updates
+    void start();
+    void stop();
+    void granted(const QLowEnergyConnectionParameters& parameters);
+    LinkParameters parameters() const;
+
+    // a command is going out
+    void activity() {
+        if (!running || chosen != LinkProfileAuto) return;
+        if (requested != LinkProfileInteractive) apply(LinkProfileInteractive);
+        timer->start(QuietPeriod);
+    }
+
+    std::function<void(const QLowEnergyConnectionParameters& parameters)> request;
+
+private slots:
+    void onQuiet();
+
+private:
+    void apply(int profile);
+
+    QTimer* timer;
+    int chosen = LinkProfileAuto;
+    bool running = false;
+    std::atomic<int> requested { 0 };
+    // microseconds, so the interval fits an atomic
+    std::atomic<int32_t> interval { 0 };
+    std::atomic<int32_t> latency { 0 };
+    std::atomic<int32_t> timeout { 0 };
+};
+
+#endif // LINKTUNER_H
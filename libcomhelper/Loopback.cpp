@@ -0,0 +1,345 @@
+#include "Loopback.h"
+
+#include <QRandomGenerator>
+#include <QMutex>
+#include <QTimer>
+#include <atomic>
+#include <cstring>
+
+namespace {
+    struct State {
+        QMutex mutex;
+        LoopbackConfig config { 50, 20, 10, 0, 2, 0, 0, 185, 10, false };
+        QList<VirtualDeviceInfo> devices;
+        QHash<quint8, QByteArray> registers;
+
+        State() {
+            devices.append(VirtualDeviceInfo {
+                "EDIFIER W820NB", QBluetoothAddress(QStringLiteral("0A:ED:1F:00:00:01")),
+                false, 0x240404, 0, QByteArray(), { }
+            });
+            devices.append(VirtualDeviceInfo {
+                "EDIFIER D32", QBluetoothAddress(QStringLiteral("0A:ED:1F:00:00:02")),
+                true, 0, 2016, QByteArray::fromHex("0AED1F0000020100"),
+                { QBluetoothUuid(QStringLiteral("00008600-0000-1000-8000-00805f9b34fb")) }
+            });
+
+            // ANC, battery, name, MAC, firmware, EQ, game mode and LDAC
+            registers.insert(0xD8, QByteArray::fromHex("0101010101010101000101000001000000004004"));
+            registers.insert(0xD0, QByteArray::fromHex("50"));
+            registers.insert(0xD5, QByteArray::fromHex("00"));
+            registers.insert(0xCC, QByteArray::fromHex("00"));
+            registers.insert(0x08, QByteArray::fromHex("00"));
+            registers.insert(0x48, QByteArray::fromHex("01"));
+            registers.insert(0x05, QByteArray::fromHex("08"));
+            registers.insert(0xC6, QByteArray::fromHex("010000"));
+            registers.insert(0xC9, QByteArrayLiteral("EDIFIER Virtual"));
+        }
+    };
+
+    State& state() {
+        static State instance;
+        return instance;
+    }
+
+    std::atomic<int> enabledState { -1 };
+
+    // set commands and the get whose register they overwrite
+    const QHash<quint8, quint8> setters {
+        { 0x06, 0x05 }, { 0x09, 0x08 }, { 0x49, 0x48 },
+        { 0xC1, 0xCC }, { 0xC4, 0xD5 }, { 0xCA, 0xC9 }
+    };
+}
+
+bool Loopback::enabled() {
+    int value = enabledState;
+    if (value < 0) {
+        value = qgetenv("COMHELPER_BACKEND") == "loopback" ? 1 : 0;
+        enabledState = value;
+    }
+
+    return value == 1;
+}
+
+void Loopback::setEnabled(bool value) {
+    enabledState = value ? 1 : 0;
+}
+
+LoopbackConfig Loopback::config() {
+    QMutexLocker locker(&state().mutex);
+    return state().config;
+}
+
+void Loopback::setConfig(const LoopbackConfig& value) {
+    QMutexLocker locker(&state().mutex);
+    state().config = value;
+}
+
+QList<VirtualDeviceInfo> Loopback::devices() {
+    QMutexLocker locker(&state().mutex);
+    return state().devices;
+}
+
+bool Loopback::find(const QBluetoothAddress& address, VirtualDeviceInfo* info) {
+    QMutexLocker locker(&state().mutex);
+    for (auto& device : state().devices) {
+        if (device.address != address) continue;
+        *info = device;
+        return true;
+    }
+
+    return false;
+}
+
+void Loopback::addDevice(const VirtualDeviceInfo& info) {
+    QMutexLocker locker(&state().mutex);
+    state().devices.append(info);
+}
+
+void Loopback::clearDevices() {
+    QMutexLocker locker(&state().mutex);
+    state().devices.clear();
+}
+
+QHash<quint8, QByteArray> Loopback::registers() {
+    QMutexLocker locker(&state().mutex);
+    return state().registers;
+}
+
+void Loopback::setRegister(quint8 type, const QByteArray& value) {
+    QMutexLocker locker(&state().mutex);
+    state().registers.insert(type, value);
+}
+
+QBluetoothAddress Loopback::adapterAddress() {
+    return QBluetoothAddress(QStringLiteral("0A:ED:1F:00:00:00"));
+}
+
+VirtualDevice::VirtualDevice(const QHash<quint8, QByteArray>& registers, bool encrypted)
+    : registers(registers), encrypted(encrypted) { }
+
+QList<QByteArray> VirtualDevice::feed(const char* data, qint64 length) {
+    QList<QByteArray> replies;
+    pending.append(data, length);
+    while (pending.size() >= 5) {
+        auto at = [this](int i) { return static_cast<quint8>(pending.at(i)); };
+        if (at(0) != 0xAA) {
+            pending.remove(0, 1);
+            continue;
+        }
+
+        bool v2 = at(1) == 0xEC;
+        if (v2 && pending.size() < 6) break;
+        int total = v2 ? ((at(3) << 8) | at(4)) + 6 : at(1) + 4;
+        if (!v2 && at(1) == 0) {
+            pending.remove(0, 1);
+            continue;
+        }
+
+        if (pending.size() < total) break;
+
+        quint16 sum = v2 ? 0 : 8217;
+        int signSize = v2 ? 1 : 2;
+        for (int i = 0; i < total - signSize; i++)
+            sum += at(i);
+        bool valid = v2 ? at(total - 1) == (sum & 0xFF)
+            : at(total - 2) == (sum >> 8) && at(total - 1) == (sum & 0xFF);
+        if (!valid) {
+            pending.remove(0, 1);
+            continue;
+        }
+
+        QByteArray payload = v2 ? pending.mid(5, total - 6) : pending.mid(3, at(1) - 1);
+        quint8 type = at(2);
+        pending.remove(0, total);
+        respond(type, payload, v2, &replies);
+    }
+
+    return replies;
+}
+
+void VirtualDevice::reset() {
+    // registers survive, like a headset keeping its settings between links
+    pending.clear();
+    hangup = false;
+}
+
+void VirtualDevice::respond(quint8 type, QByteArray payload, bool v2, QList<QByteArray>* replies) {
+    if (encrypted)
+        for (auto& byte : payload) byte ^= 0xA5;
+
+    // disconnect, shutdown and re-pair all drop the link
+    if (type == 0xCD || type == 0xCE || type == 0xCF) {
+        hangup = true;
+        return;
+    }
+
+    auto setter = setters.constFind(type);
+    if (setter != setters.constEnd()) {
+        registers.insert(setter.value(), payload);
+        replies->append(frame(type, payload, v2));
+        return;
+    }
+
+    auto it = registers.constFind(type);
+    if (it == registers.constEnd()) return;
+    replies->append(frame(type, it.value(), v2));
+}
+
+QByteArray VirtualDevice::frame(quint8 type, QByteArray payload, bool v2) const {
+    // only the v2 layout scrambles what the device sends back
+    if (encrypted && v2)
+        for (auto& byte : payload) byte ^= 0xA5;
+
+    QByteArray buf;
+    buf.append(static_cast<char>(0xBB));
+    if (v2) {
+        buf.append(static_cast<char>(0xEC));
+        buf.append(static_cast<char>(type));
+        buf.append(static_cast<char>(payload.size() >> 8));
+        buf.append(static_cast<char>(payload.size() & 0xFF));
+    } else {
+        buf.append(static_cast<char>(payload.size() + 1));
+        buf.append(static_cast<char>(type));
+    }
+
+    buf.append(payload);
+    quint16 sum = v2 ? 0 : 8217;
+    for (auto byte : buf)
+        sum += static_cast<quint8>(byte);
+    if (!v2) buf.append(static_cast<char>(sum >> 8));
+    buf.append(static_cast<char>(sum & 0xFF));
+    return buf;
+}
+
+VirtualLink::VirtualLink(const QBluetoothAddress& address, QObject* parent)
+    : QIODevice(parent), address(address), config(Loopback::config()),
+      device(Loopback::registers(), config.Encrypted) {
+    clock.start();
+}
+
+bool VirtualLink::open(OpenMode mode) {
+    if (!QIODevice::open(mode | QIODevice::Unbuffered)) return false;
+    // links are reopened when the connection reconnects
+    device.reset();
+    lastDue = 0;
+    VirtualDeviceInfo info;
+    bool known = Loopback::find(address, &info);
+    int current = session;
+    QTimer::singleShot(config.ConnectLatency, this, [this, known, current]() {
+        if (!isOpen() || current != session) return;
+        if (!known) {
+            QIODevice::close();
+            emit errorOccurred(QStringLiteral("Virtual device not found"));
+            return;
+        }
+
+        up = true;
+        emit connected();
+    });
+
+    return true;
+}
+
+void VirtualLink::close() {
+    bool wasUp = up;
+    up = false;
+    session++;
+    inbound.clear();
+    if (isOpen()) QIODevice::close();
+    if (wasUp) emit disconnected();
+}
+
+qint64 VirtualLink::readData(char* data, qint64 maxSize) {
+    qint64 count = qMin<qint64>(maxSize, inbound.size());
+    memcpy(data, inbound.constData(), count);
+    inbound.remove(0, count);
+    return count;
+}
+
+qint64 VirtualLink::writeData(const char* data, qint64 size) {
+    if (!up) return -1;
+    for (auto& reply : device.feed(data, size)) {
+        if (roll(config.DropRate)) continue;
+        schedule(reply);
+    }
+
+    if (device.hungUp() || roll(config.DisconnectRate)) {
+        int current = session;
+        QTimer::singleShot(config.Latency, this, [this, current]() {
+            if (current == session) hangup();
+        });
+    }
+
+    // the radio confirms asynchronously, like the real socket
+    QMetaObject::invokeMethod(this, [this, size]() {
+        if (up) emit bytesWritten(size);
+    }, Qt::QueuedConnection);
+    return size;
+}
+
+void VirtualLink::schedule(const QByteArray& reply) {
+    // replies keep their order even with jitter, chunks follow each other
+    qint64 jitter = config.Jitter ? QRandomGenerator::global()->bounded(config.Jitter + 1) : 0;
+    qint64 due = qMax(clock.elapsed() + config.Latency + jitter, lastDue);
+    int chunkSize = config.ChunkSize ? static_cast<int>(config.ChunkSize) : reply.size();
+    for (int offset = 0; offset < reply.size(); offset += chunkSize) {
+        QByteArray chunk = reply.mid(offset, chunkSize);
+        int current = session;
+        QTimer::singleShot(due - clock.elapsed(), this, [this, chunk, current]() {
+            if (current == session) deliver(chunk);
+        });
+        due += config.ChunkInterval;
+    }
+
+    lastDue = due;
+}
+
+void VirtualLink::deliver(const QByteArray& chunk) {
+    if (!up) return;
+    inbound.append(chunk);
+    emit readyRead();
+}
+
+void VirtualLink::hangup() {
+    if (!up) return;
+    close();
+}
+
+bool VirtualLink::roll(uint32_t perMille) const {
+    return perMille && QRandomGenerator::global()->bounded(1000u) < perMille;
+}
+
+void SetLoopbackEnabled(bool enabled) {
+    Loopback::setEnabled(enabled);
+}
+
+bool IsLoopbackEnabled() {
+    return Loopback::enabled();
+}
+
+void SetLoopbackConfig(const LoopbackConfig* config) {
+    Loopback::setConfig(*config);
+}
+
+void GetLoopbackConfig(LoopbackConfig* config) {
+    *config = Loopback::config();
+}
+
+void AddLoopbackDevice(const char* name, const char* address, bool lowEnergy, const char* serviceUuid, uint16_t manufacturerId, const char* manufacturerData, uint32_t length) {
+    VirtualDeviceInfo info {
+        QString::fromUtf8(name), QBluetoothAddress(QString::fromUtf8(address)),
+        lowEnergy, lowEnergy ? 0u : 0x240404u, manufacturerId, QByteArray(manufacturerData, length), { }
+    };
+
+    if (serviceUuid) info.serviceUuids.append(QBluetoothUuid(QString::fromUtf8(serviceUuid)));
+    Loopback::addDevice(info);
+}
+
+void ClearLoopbackDevices() {
+    Loopback::clearDevices();
+}
+
+void SetLoopbackRegister(uint8_t type, const char* data, uint32_t length) {
+    Loopback::setRegister(type, QByteArray(data, length));
+}
@@ -0,0 +1,130 @@
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+#include <QBluetoothAddress>
+#include <QBluetoothUuid>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <cstdint>
+
+struct LoopbackConfig {
+    uint32_t ConnectLatency;
+    uint32_t Latency;
+    uint32_t Jitter;
+    uint32_t ChunkSize;
+    uint32_t ChunkInterval;
+    uint32_t DropRate;       // per mille of replies
+    uint32_t DisconnectRate; // per mille of requests
+    uint32_t Mtu;
+    uint32_t AdvertisingInterval;
+    bool Encrypted;
+};
+
+struct VirtualDeviceInfo {
+    QString name;
+    QBluetoothAddress address;
+    bool lowEnergy;
+    quint32 classOfDevice;
+    quint16 manufacturerId;
+    QByteArray manufacturerData;
+    QVector<QBluetoothUuid> serviceUuids;
+};
+
+// Stand-in for the Bluetooth stack. When enabled, either through
+// COMHELPER_BACKEND=loopback or SetLoopbackEnabled, the adapter, discovery
+// and both connection classes talk to scripted virtual devices instead.
+class Loopback {
+public:
+    static bool enabled();
+    static void setEnabled(bool value);
+
+    static LoopbackConfig config();
+    static void setConfig(const LoopbackConfig& value);
+
+    static QList<VirtualDeviceInfo> devices();
+    static bool find(const QBluetoothAddress& address, VirtualDeviceInfo* info);
+    static void addDevice(const VirtualDeviceInfo& info);
+    static void clearDevices();
+
+    static QHash<quint8, QByteArray> registers();
+    static void setRegister(quint8 type, const QByteArray& value);
+
+    static QBluetoothAddress adapterAddress();
+};
+
+// Answers Edifier requests from a register file: gets return the stored
+// value, sets overwrite it and are echoed back. Unknown requests go
+// unanswered so timeouts can be exercised too.
+class VirtualDevice {
+public:
+    VirtualDevice(const QHash<quint8, QByteArray>& registers, bool encrypted);
+
+    QList<QByteArray> feed(const char* data, qint64 length);
+    bool hungUp() const { return hangup; }
+    void reset();
+
+private:
+    void respond(quint8 type, QByteArray payload, bool v2, QList<QByteArray>* replies);
+    QByteArray frame(quint8 type, QByteArray payload, bool v2) const;
+
+    QHash<quint8, QByteArray> registers;
+    QByteArray pending;
+    bool encrypted;
+    bool hangup = false;
+};
+
+// Byte stream to a virtual device, used in place of the RFCOMM socket and
+// the GATT characteristics. Replies arrive after the configured latency,
+// split into chunks, with random drops and disconnects.
+class VirtualLink : public QIODevice {
+    Q_OBJECT
+
+public:
+    VirtualLink(const QBluetoothAddress& address, QObject* parent = nullptr);
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override { return inbound.size() + QIODevice::bytesAvailable(); }
+
+signals:
+    void connected();
+    void disconnected();
+    void errorOccurred(const QString& message);
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 size) override;
+
+private:
+    void schedule(const QByteArray& reply);
+    void deliver(const QByteArray& chunk);
+    void hangup();
+    bool roll(uint32_t perMille) const;
+
+    QBluetoothAddress address;
+    LoopbackConfig config;
+    VirtualDevice device;
+    QByteArray inbound;
+    QElapsedTimer clock;
+    qint64 lastDue = 0;
+    // replies still in flight from before a close are dropped
+    int session = 0;
+    bool up = false;
+};
+
+extern "C" {
+void SetLoopbackEnabled(bool enabled);
+bool IsLoopbackEnabled();
+void SetLoopbackConfig(const LoopbackConfig* config);
+void GetLoopbackConfig(LoopbackConfig* config);
+void AddLoopbackDevice(const char* name, const char* address, bool lowEnergy, const char* serviceUuid, uint16_t manufacturerId, const char* manufacturerData, uint32_t length);
+void ClearLoopbackDevices();
+void SetLoopbackRegister(uint8_t type, const char* data, uint32_t length);
+}
+
+#endif // LOOPBACK_H
@@ -0,0 +1,88 @@
+#include "PollScheduler.h"
+
+#include <QThread>
+#include <QRandomGenerator>
+
+PollScheduler::PollScheduler() {
+    timer = new QTimer(this);
+    timer->setInterval(TickInterval);
+    connect(timer, &QTimer::timeout, this, &PollScheduler::tick);
+}
+
+PollScheduler* PollScheduler::current() {
+    static thread_local PollScheduler* scheduler = nullptr;
+    if (!scheduler) {
+        scheduler = new PollScheduler();
+        connect(QThread::currentThread(), &QThread::finished, scheduler, &QObject::deleteLater);
+    }
+
+    return scheduler;
+}
+
+void PollScheduler::add(uint64_t id, uint32_t interval, uint32_t jitter, const std::function<void()>& fire) {
+    remove(id);
+    Entry* entry = new Entry {
+        id,
+        qMax<uint32_t>(1, (interval + TickInterval - 1) / TickInterval),
+        jitter / TickInterval,
+        0, nullptr, nullptr, nullptr, fire
+    };
+
+    entries.insert(id, entry);
+    schedule(entry, 1 + QRandomGenerator::global()->bounded(entry->interval));
+    if (!timer->isActive()) timer->start();
+}
+
+void PollScheduler::remove(uint64_t id) {
+    Entry* entry = entries.take(id);
+    if (!entry) return;
+    unlink(entry);
+    delete entry;
+    if (entries.isEmpty()) timer->stop();
+}
+
+void PollScheduler::tick() {
+    cursor = (cursor + 1) % Slots;
+    Entry* entry = wheel[cursor];
+    while (entry) {
+        Entry* next = entry->next;
+        if (entry->rounds) {
+            entry->rounds--;
+        } else {
+            unlink(entry);
+            link(&firing, entry);
+        }
+
+        entry = next;
+    }
+
+    while (firing) {
+        entry = firing;
+        unlink(entry);
+        schedule(entry, entry->interval + QRandomGenerator::global()->bounded(entry->jitter + 1));
+        // the callback may remove its own entry
+        std::function<void()> fire = entry->fire;
+        fire();
+    }
+}
+
+void PollScheduler::schedule(Entry* entry, uint32_t delay) {
+    entry->rounds = (delay - 1) / Slots;
+    link(&wheel[(cursor + delay) % Slots], entry);
+}
+
+void PollScheduler::link(Entry** list, Entry* entry) {
+    entry->list = list;
+    entry->prev = nullptr;
+    entry->next = *list;
+    if (*list) (*list)->prev = entry;
+    *list = entry;
+}
+
+void PollScheduler::unlink(Entry* entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else *entry->list = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    entry->list = nullptr;
+    entry->prev = entry->next = nullptr;
+}
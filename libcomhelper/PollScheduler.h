@@ -0,0 +1,60 @@
+#ifndef POLLSCHEDULER_H
+#define POLLSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHash>
+#include <cstdint>
+#include <functional>
+
+// Hashed timer wheel for the periodic device queries, one per worker
+// thread and driven by that thread's event loop. A tick only visits the
+// slot it lands on, so its cost follows the number of queries due rather
+// than the number registered. Queries start at a random point of their
+// interval and every repeat adds up to jitter, which keeps devices
+// registered together from being queried together.
+class PollScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int TickInterval = 50;
+    static constexpr int Slots = 256;
+
+    // the wheel of the calling thread, created on first use
+    static PollScheduler* current();
+
+    ~PollScheduler() override { qDeleteAll(entries); }
+
+    void add(uint64_t id, uint32_t interval, uint32_t jitter, const std::function<void()>& fire);
+    void remove(uint64_t id);
+    int size() const { return entries.size(); }
+
+private slots:
+    void tick();
+
+private:
+    struct Entry {
+        uint64_t id;
+        uint32_t interval;
+        uint32_t jitter;
+        uint32_t rounds;
+        Entry** list;
+        Entry* prev;
+        Entry* next;
+        std::function<void()> fire;
+    };
+
+    PollScheduler();
+    void schedule(Entry* entry, uint32_t delay);
+    void link(Entry** list, Entry* entry);
+    void unlink(Entry* entry);
+
+    QTimer* timer;
+    QHash<uint64_t, Entry*> entries;
+    Entry* wheel[Slots] = {};
+    // due entries of the running tick, callbacks may remove them
+    Entry* firing = nullptr;
+    int cursor = 0;
+};
+
+#endif // POLLSCHEDULER_H
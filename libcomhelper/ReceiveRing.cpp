@@ -0,0 +1,112 @@
+#include "ReceiveRing.h"
+
+#include <cstring>
+#include <new>
+
+bool ReceiveRing::attach(void* memory, uint32_t size, int mode) {
+    detach();
+    if (!memory || size < sizeof(ReceiveRingHeader) + 64) return false;
+    if (reinterpret_cast<uintptr_t>(memory) % alignof(ReceiveRingHeader) != 0) return false;
+    uint32_t capacity = 64;
+    while (capacity * 2 <= size - sizeof(ReceiveRingHeader)) capacity *= 2;
+
+    header = new (memory) ReceiveRingHeader();
+    header->WriteCursor.store(0, std::memory_order_relaxed);
+    header->ReadCursor.store(0, std::memory_order_relaxed);
+    header->Capacity = capacity;
+    header->Reserved = 0;
+    records = static_cast<char*>(memory) + sizeof(ReceiveRingHeader);
+    mask = capacity - 1;
+    this->mode = mode;
+    return true;
+}
+
+void ReceiveRing::detach() {
+    header = nullptr;
+    records = nullptr;
+    backlog.clear();
+    backlogBytes = 0;
+}
+
+bool ReceiveRing::offer(const char* data, uint32_t length, bool* wasEmpty) {
+    *wasEmpty = false;
+    if (((sizeof(uint32_t) + length + 3) & ~3u) > mask + 1) {
+        overflow(length);
+        return false;
+    }
+
+    // frames keep their order, nothing skips ahead of the backlog
+    if (backlog.isEmpty() && push(data, length, wasEmpty)) return true;
+    if (mode != ReceiveRingBlock || backlogBytes + length > mask + 1) {
+        overflow(length);
+        return false;
+    }
+
+    if (backlog.isEmpty()) stalls.fetch_add(1, std::memory_order_relaxed);
+    backlog.enqueue(QByteArray(data, length));
+    backlogBytes += length;
+    return false;
+}
+
+bool ReceiveRing::flush(bool* wasEmpty) {
+    *wasEmpty = false;
+    while (!backlog.isEmpty()) {
+        const QByteArray& frame = backlog.head();
+        bool empty;
+        if (!push(frame.constData(), frame.length(), &empty)) return false;
+        *wasEmpty |= empty;
+        backlogBytes -= frame.length();
+        backlog.dequeue();
+    }
+
+    return true;
+}
+
+ReceiveRingStats ReceiveRing::stats() const {
+    return ReceiveRingStats {
+        recordCount.load(std::memory_order_relaxed),
+        bytes.load(std::memory_order_relaxed),
+        overflows.load(std::memory_order_relaxed),
+        overflowBytes.load(std::memory_order_relaxed),
+        stalls.load(std::memory_order_relaxed)
+    };
+}
+
+bool ReceiveRing::push(const char* data, uint32_t length, bool* wasEmpty) {
+    if (!header) return false;
+    uint32_t capacity = mask + 1;
+    uint32_t need = (sizeof(uint32_t) + length + 3) & ~3u;
+    if (need > capacity) return false;
+    uint64_t start = header->WriteCursor.load(std::memory_order_relaxed);
+    uint64_t read = header->ReadCursor.load(std::memory_order_acquire);
+    uint64_t write = start;
+    uint32_t offset = write & mask;
+    uint32_t tail = capacity - offset;
+    // records never straddle the end, the tail is skipped instead
+    if (need > tail) {
+        if (capacity - (write - read) < tail) return false;
+        uint32_t marker = ReceiveRingWrap;
+        memcpy(records + offset, &marker, sizeof(marker));
+        write += tail;
+        offset = 0;
+        header->WriteCursor.store(write, std::memory_order_release);
+    }
+
+    if (capacity - (write - read) < need) return false;
+    memcpy(records + offset, &length, sizeof(length));
+    memcpy(records + offset + sizeof(length), data, length);
+    header->WriteCursor.store(write + need, std::memory_order_release);
+    recordCount.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(length, std::memory_order_relaxed);
+
+    // pairs with the host re-reading WriteCursor after moving ReadCursor,
+    // one of the two sides always sees the other
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    *wasEmpty = header->ReadCursor.load(std::memory_order_relaxed) >= start;
+    return true;
+}
+
+void ReceiveRing::overflow(uint32_t length) {
+    overflows.fetch_add(1, std::memory_order_relaxed);
+    overflowBytes.fetch_add(length, std::memory_order_relaxed);
+}
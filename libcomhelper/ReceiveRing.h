@@ -0,0 +1,75 @@
+#ifndef RECEIVERING_H
+#define RECEIVERING_H
+
+#include <QByteArray>
+#include <QQueue>
+#include <cstdint>
+#include <atomic>
+
+enum ReceiveRingMode {
+    // frames that don't fit are dropped and counted
+    ReceiveRingDrop = 0,
+    // frames that don't fit wait in a bounded backlog and the
+    // Classic socket is no longer read until the host catches up
+    ReceiveRingBlock = 1
+};
+
+static constexpr uint32_t ReceiveRingWrap = 0xFFFFFFFF;
+
+// Placed at the start of the host's block, followed by Capacity bytes of
+// records. Each record is a 32-bit length and the frame, padded to 4 bytes.
+// A ReceiveRingWrap length means the rest up to the end is unused and the
+// next record starts at offset 0. Only the library moves WriteCursor and
+// only the host moves ReadCursor; the host is woken when a record lands in
+// a ring it had drained, so it must re-read WriteCursor after storing
+// ReadCursor before it goes back to sleep.
+struct ReceiveRingHeader {
+    std::atomic<uint64_t> WriteCursor;
+    std::atomic<uint64_t> ReadCursor;
+    uint32_t Capacity;
+    uint32_t Reserved;
+};
+
+struct ReceiveRingStats {
+    uint64_t Records;
+    uint64_t Bytes;
+    uint64_t Overflows;
+    uint64_t OverflowBytes;
+    uint64_t Stalls;
+};
+
+// Single-producer single-consumer ring in memory owned by the host, used
+// instead of the data callback so inbound frames cost one copy and no
+// allocation. The manager's thread is the producer.
+class ReceiveRing {
+public:
+    bool attach(void* memory, uint32_t size, int mode);
+    void detach();
+    bool attached() const { return header != nullptr; }
+    bool stalled() const { return !backlog.isEmpty(); }
+
+    // false when the frame had to be dropped or put in the backlog
+    bool offer(const char* data, uint32_t length, bool* wasEmpty);
+    // moves the backlog over, true once it is empty
+    bool flush(bool* wasEmpty);
+
+    ReceiveRingStats stats() const;
+
+private:
+    bool push(const char* data, uint32_t length, bool* wasEmpty);
+    void overflow(uint32_t length);
+
+    ReceiveRingHeader* header = nullptr;
+    char* records = nullptr;
+    uint32_t mask = 0;
+    int mode = ReceiveRingDrop;
+    QQueue<QByteArray> backlog;
+    uint32_t backlogBytes = 0;
+    std::atomic<uint64_t> recordCount { 0 };
+    std::atomic<uint64_t> bytes { 0 };
+    std::atomic<uint64_t> overflows { 0 };
+    std::atomic<uint64_t> overflowBytes { 0 };
+    std::atomic<uint64_t> stalls { 0 };
+};
+
+#endif // RECEIVERING_H
@@ -0,0 +1,185 @@
+#include "SessionGroup.h"
+
+#include <ApplicationLoop.h>
+#include <BluetoothClassic.h>
+#include <BluetoothLowEnergy.h>
+#include <EventQueue.h>
+#include <QHash>
+#include <QSharedPointer>
+
+namespace {
+    struct Broadcast {
+        uint64_t id;
+        const void* source;
+        GroupCallback callback;
+        QVector<GroupResult> results;
+        QVector<QByteArray> responses;
+        int remaining;
+    };
+
+    struct Registry {
+        QMutex mutex;
+        // member operation id to its broadcast and result slot
+        QHash<uint64_t, QPair<QSharedPointer<Broadcast>, int>> operations;
+    };
+
+    Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    // skips the lock for every ordinary write while no broadcast is running
+    std::atomic<int> outstanding { 0 };
+
+    template<typename T>
+    void dispatch(T* member, uint64_t id, const QByteArray& data, int responseType, int timeout) {
+        QMetaObject::invokeMethod(member, [=]() {
+            member->transactor->enqueue(PendingTransaction { id, data, responseType, timeout });
+        }, Qt::QueuedConnection);
+    }
+
+    void finish(const Broadcast& broadcast) {
+        QVector<GroupResult> results = broadcast.results;
+        if (EventQueue::enabled()) {
+            // member, status and response length per device, responses stay
+            // behind; a large group is split so no record gets truncated
+            const int perEvent = EventPayloadSize / 16;
+            int first = 0;
+            do {
+                int count = qMin(perEvent, results.size() - first);
+                QByteArray payload;
+                for (int i = first; i < first + count; i++) {
+                    uint64_t member = reinterpret_cast<uintptr_t>(results[i].Member);
+                    payload.append(reinterpret_cast<const char*>(&member), sizeof(member));
+                    payload.append(reinterpret_cast<const char*>(&results[i].Status), sizeof(results[i].Status));
+                    payload.append(reinterpret_cast<const char*>(&results[i].Length), sizeof(results[i].Length));
+                }
+
+                EventQueue::instance()->push(EventGroupCompleted, broadcast.source, results.size(), broadcast.id,
+                                             payload.constData(), payload.length(), static_cast<uint32_t>(first) << EventGroupOffsetShift);
+                first += count;
+            } while (first < results.size());
+            return;
+        }
+
+        if (!broadcast.callback) return;
+        for (int i = 0; i < results.size(); i++)
+            results[i].Data = broadcast.responses.at(i).isEmpty() ? nullptr : broadcast.responses.at(i).constData();
+        broadcast.callback(broadcast.id, results.constData(), results.size());
+    }
+}
+
+void SessionGroup::add(QObject* member) {
+    QMutexLocker locker(&mutex);
+    if (!members.contains(member)) members.append(member);
+}
+
+void SessionGroup::remove(QObject* member) {
+    QMutexLocker locker(&mutex);
+    members.removeAll(member);
+}
+
+int SessionGroup::size() {
+    QMutexLocker locker(&mutex);
+    return members.size();
+}
+
+uint64_t SessionGroup::broadcast(const QByteArray& data, int responseType, int timeout) {
+    QVector<QObject*> targets;
+    {
+        QMutexLocker locker(&mutex);
+        targets = members;
+    }
+
+    auto pending = QSharedPointer<Broadcast>::create();
+    pending->id = WriteQueue::nextId();
+    pending->source = this;
+    pending->callback = callback;
+    pending->results.resize(targets.size());
+    pending->responses.resize(targets.size());
+    pending->remaining = targets.size();
+    if (targets.isEmpty()) {
+        // the caller has to have the id before its completion can match it
+        QMetaObject::invokeMethod(GetApplication(), [pending]() {
+            finish(*pending);
+        }, Qt::QueuedConnection);
+        return pending->id;
+    }
+
+    QVector<uint64_t> ids(targets.size());
+    {
+        // registered before anything is dispatched, a fast member may finish right away
+        QMutexLocker locker(&registry().mutex);
+        for (int i = 0; i < targets.size(); i++) {
+            ids[i] = WriteQueue::nextId();
+            pending->results[i] = GroupResult { targets[i], WriteAborted, 0, nullptr };
+            registry().operations.insert(ids[i], qMakePair(pending, i));
+        }
+
+        outstanding += targets.size();
+    }
+
+    for (int i = 0; i < targets.size(); i++) {
+        if (auto classic = qobject_cast<BluetoothClassic*>(targets[i]))
+            dispatch(classic, ids[i], data, responseType, timeout);
+        else if (auto lowEnergy = qobject_cast<BluetoothLowEnergy*>(targets[i]))
+            dispatch(lowEnergy, ids[i], data, responseType, timeout);
+        else complete(ids[i], WriteNotConnected);
+    }
+
+    return pending->id;
+}
+
+bool SessionGroup::complete(uint64_t id, int status, const char* data, uint32_t length) {
+    if (outstanding.load(std::memory_order_acquire) == 0) return false;
+    QSharedPointer<Broadcast> done;
+    {
+        QMutexLocker locker(&registry().mutex);
+        auto it = registry().operations.find(id);
+        if (it == registry().operations.end()) return false;
+        auto broadcast = it.value().first;
+        int index = it.value().second;
+        registry().operations.erase(it);
+        outstanding--;
+        broadcast->results[index].Status = status;
+        broadcast->results[index].Length = data ? length : 0;
+        if (data) broadcast->responses[index] = QByteArray(data, length);
+        if (--broadcast->remaining == 0) done = broadcast;
+    }
+
+    // reported from the thread of whichever member finished last
+    if (done) finish(*done);
+    return true;
+}
+
+SessionGroup* CreateSessionGroup() {
+    return new SessionGroup();
+}
+
+void DestroySessionGroup(SessionGroup* group) {
+    delete group;
+}
+
+void AddGroupMember(SessionGroup* group, void* member) {
+    group->add(static_cast<QObject*>(member));
+}
+
+void RemoveGroupMember(SessionGroup* group, void* member) {
+    group->remove(static_cast<QObject*>(member));
+}
+
+int GetGroupSize(SessionGroup* group) {
+    return group->size();
+}
+
+void SetGroupCompletedCallback(SessionGroup* group, GroupCallback callback) {
+    group->callback = callback;
+}
+
+uint64_t GroupWrite(SessionGroup* group, const char* data, uint32_t length) {
+    return group->broadcast(QByteArray(data, length), -1, 0);
+}
+
+uint64_t GroupTransact(SessionGroup* group, const char* data, uint32_t length, int responseType, int timeout) {
+    return group->broadcast(QByteArray(data, length), responseType, timeout);
+}
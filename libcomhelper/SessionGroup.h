@@ -0,0 +1,57 @@
+#ifndef SESSIONGROUP_H
+#define SESSIONGROUP_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QVector>
+#include <QMutex>
+#include <cstdint>
+#include <atomic>
+
+struct GroupResult {
+    void* Member;
+    int32_t Status;
+    uint32_t Length;
+    // transaction response, only valid while the callback runs
+    const char* Data;
+};
+
+typedef void (*GroupCallback)(uint64_t id, const GroupResult* results, uint32_t count);
+
+// Connections that get the same writes or transactions. A broadcast is
+// queued on every member's worker thread at once and reported through one
+// completion when the last member finishes, so it takes as long as the
+// slowest device rather than the sum of them. Members are not owned and
+// have to be removed before they are destroyed.
+class SessionGroup {
+public:
+    void add(QObject* member);
+    void remove(QObject* member);
+    int size();
+
+    // negative response types write without waiting for a response
+    uint64_t broadcast(const QByteArray& data, int responseType, int timeout);
+
+    // every finished write and transaction goes through here first, true
+    // when it belonged to a broadcast
+    static bool complete(uint64_t id, int status, const char* data = nullptr, uint32_t length = 0);
+
+    std::atomic<GroupCallback> callback { nullptr };
+
+private:
+    QMutex mutex;
+    QVector<QObject*> members;
+};
+
+extern "C" {
+SessionGroup* CreateSessionGroup();
+void DestroySessionGroup(SessionGroup* group);
+void AddGroupMember(SessionGroup* group, void* member);
+void RemoveGroupMember(SessionGroup* group, void* member);
+int GetGroupSize(SessionGroup* group);
+void SetGroupCompletedCallback(SessionGroup* group, GroupCallback callback);
+uint64_t GroupWrite(SessionGroup* group, const char* data, uint32_t length);
+uint64_t GroupTransact(SessionGroup* group, const char* data, uint32_t length, int responseType, int timeout);
+}
+
+#endif // SESSIONGROUP_H
@@ -0,0 +1,108 @@
+#include "StateCache.h"
+
+#include <Codec.h>
+#include <QDateTime>
+#include <QtAlgorithms>
+#include <cstring>
+
+StateCache::StateCache() {
+    clock.start();
+    reset();
+}
+
+uint32_t StateCache::field(uint8_t type) {
+    switch (type) {
+    case 0xD0:
+        return StateBattery;
+    case 0xCC: case 0xC1:
+        return StateAnc;
+    case 0xD5: case 0xC4:
+        return StateEqualizer;
+    case 0x08: case 0x09:
+        return StateGameMode;
+    case 0x48: case 0x49:
+        return StateLdac;
+    case 0xD3: case 0xD1: case 0xD2:
+        return StateShutdownTimer;
+    case 0xC3:
+        return StatePlayback;
+    default:
+        return 0;
+    }
+}
+
+void StateCache::setEnabled(bool enabled, bool encrypted) {
+    scrambled = encrypted;
+    active = enabled;
+}
+
+uint32_t StateCache::update(const char* frame, uint32_t length) {
+    // type byte sits at the same offset in both header layouts, everything
+    // else (song names, feature lists) is skipped before decoding
+    if (length < 3) return 0;
+    uint8_t type = static_cast<uint8_t>(frame[2]);
+    uint32_t field = StateCache::field(type);
+    if (!field) return 0;
+
+    uint8_t payload[16];
+    int version = static_cast<uint8_t>(frame[1]) == 0xEC ? 2 : 1;
+    int32_t size = Codec::decode(version, scrambled, reinterpret_cast<const uint8_t*>(frame), length, &type, payload, sizeof(payload));
+    if (size < 0 || (size == 0 && type != 0xD2)) return 0;
+
+    QMutexLocker locker(&mutex);
+    seen[qCountTrailingZeroBits(field)] = clock.elapsed();
+    DeviceSnapshot next = state;
+    switch (type) {
+    case 0xD0:
+        next.Battery = payload[0];
+        break;
+    case 0xCC: case 0xC1:
+        next.AncMode = payload[0];
+        next.AncExtra[0] = size > 1 ? payload[1] : 0;
+        next.AncExtra[1] = size > 2 ? payload[2] : 0;
+        break;
+    case 0xD5: case 0xC4:
+        next.Equalizer = payload[0];
+        break;
+    case 0x08: case 0x09:
+        next.GameMode = payload[0] > 0;
+        break;
+    case 0x48: case 0x49:
+        next.Ldac = payload[0];
+        break;
+    case 0xD3: case 0xD1:
+        next.ShutdownTimer = size < 2 ? payload[0] : payload[0] | payload[1] << 8;
+        break;
+    case 0xD2:
+        next.ShutdownTimer = 0;
+        break;
+    default:
+        // 0x0D is playing, 0x03 paused
+        next.Playing = payload[0] == 0x0D;
+        break;
+    }
+
+    next.Valid |= field;
+    if (memcmp(&next, &state, sizeof(next)) == 0) return 0;
+    next.Sequence++;
+    next.Updated = QDateTime::currentMSecsSinceEpoch();
+    state = next;
+    return field;
+}
+
+DeviceSnapshot StateCache::snapshot() {
+    QMutexLocker locker(&mutex);
+    return state;
+}
+
+int64_t StateCache::age(uint32_t field) {
+    QMutexLocker locker(&mutex);
+    int64_t at = seen[qCountTrailingZeroBits(field)];
+    return at < 0 ? -1 : clock.elapsed() - at;
+}
+
+void StateCache::reset() {
+    QMutexLocker locker(&mutex);
+    state = DeviceSnapshot {};
+    for (int64_t& at : seen) at = -1;
+}
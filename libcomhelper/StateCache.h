@@ -0,0 +1,77 @@
+#ifndef STATECACHE_H
+#define STATECACHE_H
+
+#include <QMutex>
+#include <QElapsedTimer>
+#include <cstdint>
+#include <atomic>
+
+enum StateField {
+    StateBattery = 1,
+    StateAnc = 2,
+    StateEqualizer = 4,
+    StateGameMode = 8,
+    StateLdac = 16,
+    StateShutdownTimer = 32,
+    StatePlayback = 64
+};
+
+// ANC and equalizer hold the raw index the device reported, mapping it to
+// a mode or preset depends on the product and is left to the host
+struct DeviceSnapshot {
+    uint32_t Valid;
+    uint32_t Sequence;
+    // milliseconds since the epoch of the last change
+    uint64_t Updated;
+    uint8_t Battery;
+    uint8_t AncMode;
+    uint8_t AncExtra[2];
+    uint8_t Equalizer;
+    uint8_t GameMode;
+    uint8_t Ldac;
+    uint8_t Playing;
+    uint16_t ShutdownTimer;
+    uint16_t Reserved;
+};
+
+typedef void (*StateCallback)(uint32_t changed, const DeviceSnapshot* snapshot);
+
+// Mirror of the device settings that arrive in well-known inbound frames,
+// both answers to gets and the echoes of sets, so the host can read them
+// without asking the device again.
+class StateCache {
+public:
+    StateCache();
+
+    // the field a frame type reports, 0 for types the mirror ignores
+    static uint32_t field(uint8_t type);
+
+    void setEnabled(bool enabled, bool encrypted);
+    bool enabled() const {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    bool encrypted() const {
+        return scrambled.load(std::memory_order_relaxed);
+    }
+
+    // returns the fields that changed
+    uint32_t update(const char* frame, uint32_t length);
+    DeviceSnapshot snapshot();
+    // milliseconds since a frame last reported the field, changed or not;
+    // -1 when none has yet
+    int64_t age(uint32_t field);
+    void reset();
+
+private:
+    QMutex mutex;
+    static constexpr int FieldCount = 7;
+
+    DeviceSnapshot state {};
+    QElapsedTimer clock;
+    int64_t seen[FieldCount];
+    std::atomic<bool> active { false };
+    std::atomic<bool> scrambled { false };
+};
+
+#endif // STATECACHE_H
@@ -0,0 +1,64 @@
+#include "Supervisor.h"
+
+#include <QRandomGenerator>
+
+Supervisor::Supervisor(QObject* parent) : QObject(parent) {
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &Supervisor::onTimeout);
+}
+
+void Supervisor::setPolicy(const ReconnectPolicy& value) {
+    policy = value;
+    if (!policy.Enabled && state == SupervisorBackoff) {
+        timer->stop();
+        state = SupervisorIdle;
+    }
+}
+
+void Supervisor::start() {
+    timer->stop();
+    attempts = 0;
+    state = SupervisorConnecting;
+}
+
+bool Supervisor::ready() {
+    bool resume = state == SupervisorReconnecting;
+    attempts = 0;
+    state = SupervisorReady;
+    if (resume) resumed++;
+    return resume;
+}
+
+bool Supervisor::lost() {
+    if (state == SupervisorBackoff) return true;
+    if (!policy.Enabled || (state != SupervisorReady && state != SupervisorReconnecting)) return false;
+    if (policy.MaxAttempts && attempts >= policy.MaxAttempts) {
+        state = SupervisorLost;
+        return false;
+    }
+
+    // equal jitter: at least half the exponential delay, so a headset that
+    // walked out of range briefly is picked up again quickly
+    uint32_t delay = policy.InitialDelay;
+    for (uint32_t i = 0; i < attempts && delay < policy.MaxDelay; i++)
+        delay *= 2;
+    delay = qMin(delay, policy.MaxDelay);
+    delay = delay / 2 + QRandomGenerator::global()->bounded(delay / 2 + 1);
+    attempts++;
+    state = SupervisorBackoff;
+    timer->start(delay);
+    return true;
+}
+
+void Supervisor::stop() {
+    timer->stop();
+    attempts = 0;
+    if (state != SupervisorLost) state = SupervisorIdle;
+}
+
+void Supervisor::onTimeout() {
+    if (state != SupervisorBackoff) return;
+    state = SupervisorReconnecting;
+    if (retry) retry();
+}
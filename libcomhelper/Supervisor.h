@@ -0,0 +1,70 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+
+enum SupervisorState {
+    SupervisorIdle = 0,
+    SupervisorConnecting = 1,
+    SupervisorReady = 2,
+    // retries ran out, the connection was torn down
+    SupervisorLost = 3,
+    SupervisorBackoff = 4,
+    SupervisorReconnecting = 5
+};
+
+struct ReconnectPolicy {
+    uint32_t Enabled;
+    uint32_t InitialDelay;
+    uint32_t MaxDelay;
+    // 0 keeps trying until the host disconnects
+    uint32_t MaxAttempts;
+};
+
+// Decides whether a dropped link is retried. Only links that were ready
+// once are supervised; each retry waits a jittered, exponentially growing
+// delay and the connection reuses its controller or socket for it.
+class Supervisor : public QObject {
+    Q_OBJECT
+
+public:
+    explicit Supervisor(QObject* parent = nullptr);
+
+    void setPolicy(const ReconnectPolicy& value);
+    void start();
+    // true when the link came back from a reconnect
+    bool ready();
+    // true when a retry was scheduled, false when the link should be torn down
+    bool lost();
+    void stop();
+
+    bool waiting() const {
+        return state == SupervisorBackoff;
+    }
+
+    int current() const {
+        return state;
+    }
+
+    uint64_t resumes() const {
+        return resumed;
+    }
+
+    std::function<void()> retry;
+
+private slots:
+    void onTimeout();
+
+private:
+    ReconnectPolicy policy { 0, 100, 5000, 0 };
+    std::atomic<int> state { SupervisorIdle };
+    std::atomic<uint64_t> resumed { 0 };
+    uint32_t attempts = 0;
+    QTimer* timer;
+};
+
+#endif // SUPERVISOR_H
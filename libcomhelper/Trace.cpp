@@ -0,0 +1,201 @@
+#include "Trace.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QPair>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+#include <chrono>
+
+std::atomic<bool> Trace::on { false };
+
+namespace {
+    struct Slot {
+        std::atomic<uint64_t> timestamp { 0 };
+        std::atomic<uint64_t> source { 0 };
+        std::atomic<uint64_t> id { 0 };
+        // point << 32 | value
+        std::atomic<uint64_t> detail { 0 };
+    };
+
+    struct Ring {
+        std::atomic<uint64_t> head { 0 };
+        // events below this were cleared
+        std::atomic<uint64_t> floor { 0 };
+        int index;
+        QByteArray name;
+        Slot slots[Trace::Capacity];
+    };
+
+    struct Registry {
+        QMutex mutex;
+        // rings outlive their threads so a dump still shows them, until a
+        // new thread takes one over from the spares
+        QVector<Ring*> rings;
+        QVector<Ring*> spare;
+        int threads = 0;
+    };
+
+    Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    // host threads calling the C API come and go, so rings are handed back
+    // when their thread ends instead of growing the registry per thread
+    struct Owner {
+        Ring* ring = nullptr;
+
+        ~Owner() {
+            if (!ring) return;
+            QMutexLocker locker(&registry().mutex);
+            registry().spare.append(ring);
+        }
+    };
+
+    Ring* acquire() {
+        QMutexLocker locker(&registry().mutex);
+        Ring* ring;
+        if (registry().spare.isEmpty()) {
+            ring = new Ring();
+            registry().rings.append(ring);
+        } else {
+            ring = registry().spare.takeLast();
+            ring->floor.store(ring->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        ring->index = ++registry().threads;
+        QString name = QThread::currentThread()->objectName();
+        ring->name = name.isEmpty() ? QByteArray("thread-") + QByteArray::number(ring->index) : name.toUtf8();
+        return ring;
+    }
+
+    uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    const char* pointName(int point) {
+        switch (point) {
+        case TraceWriteEnqueued: return "write enqueued";
+        case TraceSocketWrite: return "socket write";
+        case TraceBytesWritten: return "bytes written";
+        case TraceNotification: return "notification";
+        case TraceCallbackEnter:
+        case TraceCallbackExit: return "callback";
+        case TraceDispatchPosted: return "dispatch posted";
+        case TraceDispatchRun: return "dispatch run";
+        default: return "unknown";
+        }
+    }
+}
+
+void Trace::setEnabled(bool enabled) {
+    on.store(enabled, std::memory_order_relaxed);
+}
+
+void Trace::clear() {
+    QMutexLocker locker(&registry().mutex);
+    for (Ring* ring : registry().rings) {
+        ring->floor.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+void Trace::record(int point, const void* source, uint64_t id, uint32_t value) {
+    static thread_local Owner owner;
+    if (!owner.ring) owner.ring = acquire();
+
+    Ring* ring = owner.ring;
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Slot& slot = ring->slots[head % Capacity];
+    slot.timestamp.store(now(), std::memory_order_relaxed);
+    slot.source.store(reinterpret_cast<uintptr_t>(source), std::memory_order_relaxed);
+    slot.id.store(id, std::memory_order_relaxed);
+    slot.detail.store(static_cast<uint64_t>(point) << 32 | value, std::memory_order_relaxed);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Trace::dump(const QString& path) {
+    struct Copy {
+        uint64_t timestamp;
+        uint64_t source;
+        uint64_t id;
+        uint64_t detail;
+        int thread;
+    };
+
+    QVector<Copy> events;
+    QVector<QPair<int, QByteArray>> threads;
+    {
+        QMutexLocker locker(&registry().mutex);
+        for (Ring* ring : registry().rings) {
+            threads.append(qMakePair(ring->index, ring->name));
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            uint64_t from = std::max(ring->floor.load(std::memory_order_relaxed), head < Capacity ? 0 : head - Capacity);
+            int start = events.size();
+            for (uint64_t i = from; i < head; i++) {
+                const Slot& slot = ring->slots[i % Capacity];
+                events.append(Copy {
+                    slot.timestamp.load(std::memory_order_relaxed),
+                    slot.source.load(std::memory_order_relaxed),
+                    slot.id.load(std::memory_order_relaxed),
+                    slot.detail.load(std::memory_order_relaxed),
+                    ring->index
+                });
+            }
+
+            // the owner kept writing, anything it lapped is garbage
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t after = ring->head.load(std::memory_order_relaxed);
+            if (after > Capacity && after - Capacity > from)
+                events.remove(start, std::min<int>(events.size() - start, after - Capacity - from));
+        }
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    std::sort(events.begin(), events.end(), [](const Copy& a, const Copy& b) {
+        return a.timestamp < b.timestamp;
+    });
+
+    uint64_t origin = events.isEmpty() ? 0 : events.first().timestamp;
+    QList<QByteArray> lines;
+    for (const auto& thread : threads) {
+        lines.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + QByteArray::number(thread.first)
+            + ",\"args\":{\"name\":\"" + thread.second + "\"}}");
+    }
+
+    for (const Copy& event : events) {
+        int point = static_cast<int>(event.detail >> 32);
+        uint32_t value = static_cast<uint32_t>(event.detail);
+        const char* phase = point == TraceCallbackEnter ? "B" : point == TraceCallbackExit ? "E" : "i";
+        QByteArray line = QByteArray("{\"name\":\"") + pointName(point) + "\",\"ph\":\"" + phase + "\"";
+        if (*phase == 'i') line += ",\"s\":\"t\"";
+        line += ",\"ts\":" + QByteArray::number((event.timestamp - origin) / 1000.0, 'f', 3)
+            + ",\"pid\":1,\"tid\":" + QByteArray::number(event.thread)
+            + ",\"args\":{\"source\":\"0x" + QByteArray::number(static_cast<qulonglong>(event.source), 16)
+            + "\",\"id\":" + QByteArray::number(static_cast<qulonglong>(event.id))
+            + ",\"value\":" + QByteArray::number(value) + "}}";
+        lines.append(line);
+    }
+
+    QByteArray out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" + lines.join(",\n") + "\n]}\n";
+    return file.write(out) == out.size();
+}
+
+void SetTraceEnabled(bool enabled) {
+    Trace::setEnabled(enabled);
+}
+
+bool IsTraceEnabled() {
+    return Trace::enabled();
+}
+
+void ClearTrace() {
+    Trace::clear();
+}
+
+bool DumpTrace(const char* path) {
+    return Trace::dump(QString::fromUtf8(path));
+}
@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QByteArray>
+#include <QString>
+#include <cstdint>
+#include <atomic>
+
+enum TracePoint {
+    // the host handed a write or transaction over, Value is its size
+    TraceWriteEnqueued = 1,
+    // bytes went to the socket or characteristic
+    TraceSocketWrite = 2,
+    // the transport confirmed them
+    TraceBytesWritten = 3,
+    // bytes arrived from the socket or a notification
+    TraceNotification = 4,
+    // around a host callback, Value is the EventType
+    TraceCallbackEnter = 5,
+    TraceCallbackExit = 6,
+    // a call queued to a connection's thread and the moment it runs there
+    TraceDispatchPosted = 7,
+    TraceDispatchRun = 8
+};
+
+// Fixed-size events in a ring per thread. Only the owning thread writes
+// its ring, so recording is a few relaxed stores; a dump copies the rings
+// and drops whatever was overwritten while it copied. A ring is passed on
+// to the next thread once its owner ends, so the memory held is set by how
+// many threads trace at the same time. With tracing off a trace point is
+// one relaxed load.
+class Trace {
+public:
+    static constexpr uint32_t Capacity = 8192;
+
+    static bool enabled() {
+        return on.load(std::memory_order_relaxed);
+    }
+
+    static void mark(int point, const void* source, uint64_t id = 0, uint32_t value = 0) {
+        if (enabled()) record(point, source, id, value);
+    }
+
+    static void setEnabled(bool enabled);
+    static void clear();
+    // Chrome trace event JSON, loads in chrome://tracing and Perfetto
+    static bool dump(const QString& path);
+
+private:
+    static void record(int point, const void* source, uint64_t id, uint32_t value);
+
+    static std::atomic<bool> on;
+};
+
+extern "C" {
+void SetTraceEnabled(bool enabled);
+bool IsTraceEnabled();
+void ClearTrace();
+bool DumpTrace(const char* path);
+}
+
+#endif // TRACE_H
@@ -0,0 +1,63 @@
+#include "Transactor.h"
+
+Transactor::Transactor(QObject* parent) : QObject(parent) {
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &Transactor::onTimeout);
+}
+
+void Transactor::enqueue(const PendingTransaction& transaction) {
+    queue.enqueue(transaction);
+    if (!busy) next();
+}
+
+bool Transactor::consume(const char* data, uint32_t length) {
+    // type byte sits at the same offset in both header layouts
+    if (!busy || current.responseType < 0 || length < 3) return false;
+    if (static_cast<uint8_t>(data[2]) != current.responseType) return false;
+    finish(WriteCompleted, data, length);
+    return true;
+}
+
+bool Transactor::owns(uint64_t id) const {
+    return busy && current.id == id;
+}
+
+void Transactor::writeFinished(uint64_t id, int status) {
+    if (!owns(id)) return;
+    if (status != WriteCompleted) finish(status);
+    else if (current.responseType < 0) finish(WriteCompleted);
+}
+
+void Transactor::abort(int status) {
+    QQueue<PendingTransaction> pending;
+    pending.swap(queue);
+    if (busy) finish(status);
+    while (!pending.isEmpty()) {
+        uint64_t id = pending.dequeue().id;
+        if (completed) completed(id, status, nullptr, 0);
+    }
+}
+
+void Transactor::onTimeout() {
+    if (busy) finish(WriteTimedOut);
+}
+
+void Transactor::next() {
+    if (busy || queue.isEmpty()) return;
+    current = queue.dequeue();
+    busy = true;
+    if (current.responseType >= 0) timer->start(current.timeout);
+    elapsed.start();
+    send(current.id, current.data);
+}
+
+void Transactor::finish(int status, const char* data, uint32_t length) {
+    timer->stop();
+    busy = false;
+    if (data && monitor) monitor->roundTrip(elapsed.nsecsElapsed() / 1000);
+    uint64_t id = current.id;
+    current = PendingTransaction();
+    if (completed) completed(id, status, data, length);
+    next();
+}
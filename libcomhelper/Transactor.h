@@ -0,0 +1,54 @@
+#ifndef TRANSACTOR_H
+#define TRANSACTOR_H
+
+#include <WriteQueue.h>
+#include <ConnectionMonitor.h>
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QQueue>
+#include <functional>
+
+typedef void (*TransactCallback)(uint64_t id, int status, const char* data, uint32_t length);
+
+struct PendingTransaction {
+    uint64_t id;
+    QByteArray data;
+    int responseType;
+    int timeout;
+};
+
+// Keeps to the device's one-outstanding-request rule: a request is written
+// only after the previous one got its response or timed out. Requests with
+// a negative response type complete as soon as their write does.
+class Transactor : public QObject {
+    Q_OBJECT
+
+public:
+    explicit Transactor(QObject* parent = nullptr);
+
+    void enqueue(const PendingTransaction& transaction);
+    bool consume(const char* data, uint32_t length);
+    bool owns(uint64_t id) const;
+    void writeFinished(uint64_t id, int status);
+    void abort(int status);
+
+    std::function<void(uint64_t id, const QByteArray& data)> send;
+    std::function<void(uint64_t id, int status, const char* data, uint32_t length)> completed;
+    ConnectionMonitor* monitor = nullptr;
+
+private slots:
+    void onTimeout();
+
+private:
+    void next();
+    void finish(int status, const char* data = nullptr, uint32_t length = 0);
+
+    QQueue<PendingTransaction> queue;
+    PendingTransaction current;
+    bool busy = false;
+    QTimer* timer;
+    QElapsedTimer elapsed;
+};
+
+#endif // TRANSACTOR_H
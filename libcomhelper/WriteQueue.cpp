@@ -0,0 +1,74 @@
+#include "WriteQueue.h"
+
+#include <atomic>
+
+uint64_t WriteQueue::nextId() {
+    static std::atomic<uint64_t> counter { 0 };
+    return ++counter;
+}
+
+void WriteQueue::enqueue(uint64_t id, const QByteArray& data) {
+    queued.enqueue(PendingWrite { id, data, data.length() });
+}
+
+bool WriteQueue::hasQueued() const {
+    return !queued.isEmpty();
+}
+
+bool WriteQueue::hasInflight() const {
+    return !inflight.isEmpty();
+}
+
+QByteArray WriteQueue::takeCoalesced(int limit) {
+    if (queued.length() == 1) {
+        inflight.enqueue(queued.dequeue());
+        return inflight.last().data;
+    }
+
+    // back-to-back commands go out as one socket write
+    QByteArray buf;
+    while (!queued.isEmpty()) {
+        if (!buf.isEmpty() && buf.length() + queued.head().data.length() > limit) break;
+        inflight.enqueue(queued.dequeue());
+        buf.append(inflight.last().data);
+    }
+
+    return buf;
+}
+
+const PendingWrite& WriteQueue::takeNext() {
+    inflight.enqueue(queued.dequeue());
+    return inflight.last();
+}
+
+const PendingWrite& WriteQueue::current() const {
+    return inflight.head();
+}
+
+void WriteQueue::acknowledge(qint64 bytes, const WriteHandler& handler) {
+    while (bytes > 0 && !inflight.isEmpty()) {
+        PendingWrite& write = inflight.head();
+        qint64 count = qMin(bytes, write.remaining);
+        write.remaining -= count;
+        bytes -= count;
+        if (write.remaining > 0) break;
+        uint64_t id = write.id;
+        inflight.dequeue();
+        handler(id, WriteCompleted);
+    }
+}
+
+void WriteQueue::failInflight(int status, const WriteHandler& handler) {
+    while (!inflight.isEmpty()) {
+        uint64_t id = inflight.dequeue().id;
+        handler(id, status);
+    }
+}
+
+void WriteQueue::failAll(int status, const WriteHandler& handler) {
+    failInflight(status, handler);
+    while (!queued.isEmpty()) {
+        uint64_t id = queued.dequeue().id;
+        handler(id, status);
+    }
+}
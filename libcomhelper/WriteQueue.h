@@ -0,0 +1,50 @@
+#ifndef WRITEQUEUE_H
+#define WRITEQUEUE_H
+
+#include <QByteArray>
+#include <QQueue>
+#include <cstdint>
+#include <functional>
+
+typedef void (*WriteCallback)(uint64_t id, int status);
+typedef std::function<void(uint64_t id, int status)> WriteHandler;
+
+enum WriteStatus {
+    WriteCompleted = 0,
+    WriteFailed = -1,
+    WriteNotConnected = -2,
+    WriteAborted = -3,
+    WriteTimedOut = -4
+};
+
+struct PendingWrite {
+    uint64_t id;
+    QByteArray data;
+    qint64 remaining;
+};
+
+// Per-connection outbound queue. Writes are copied in by the caller's
+// thread and moved to inflight once handed to the transport, where they
+// wait for the transport to confirm the bytes.
+class WriteQueue {
+public:
+    static uint64_t nextId();
+
+    void enqueue(uint64_t id, const QByteArray& data);
+    bool hasQueued() const;
+    bool hasInflight() const;
+
+    QByteArray takeCoalesced(int limit);
+    const PendingWrite& takeNext();
+    const PendingWrite& current() const;
+
+    void acknowledge(qint64 bytes, const WriteHandler& handler);
+    void failInflight(int status, const WriteHandler& handler);
+    void failAll(int status, const WriteHandler& handler);
+
+private:
+    QQueue<PendingWrite> queued;
+    QQueue<PendingWrite> inflight;
+};
+
+#endif // WRITEQUEUE_H
@@ -0,0 +1,16 @@
+QT += bluetooth
+QT -= gui
+
+TEMPLATE = app
+TARGET = comhelper-benchmark
+CONFIG += c++17 console
+CONFIG -= app_bundle
+DESTDIR = ../build
+
+# Runs against the loopback backend, build the library first
+INCLUDEPATH += $$PWD/..
+LIBS += -L$$OUT_PWD/../build -lcomhelper
+unix:!macx: QMAKE_RPATHDIR += $$OUT_PWD/../build
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,335 @@
+#include <ApplicationLoop.h>
+#include <BluetoothAdapter.h>
+#include <BluetoothClassic.h>
+#include <BluetoothDiscovery.h>
+#include <BluetoothLowEnergy.h>
+#include <Executor.h>
+#include <Loopback.h>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Measures the hot paths of libcomhelper against the loopback backend so it
+// runs on any box. Usage: comhelper-benchmark [-n iterations] [--json file] [--csv file]
+
+struct Result {
+    QString name;
+    QString unit;
+    int samples;
+    double mean;
+    double p50;
+    double p99;
+    double min;
+    double max;
+    double rate;
+};
+
+static const char* ClassicAddress = "0A:ED:1F:00:00:01";
+static const char* LowEnergyAddress = "0A:ED:1F:00:00:02";
+static const char* ServiceUuid = "48098601-1a48-11e9-ab14-d663bd873d93";
+static const char* WriteUuid = "48090002-1a48-11e9-ab14-d663bd873d93";
+static const char* ReadUuid = "48090001-1a48-11e9-ab14-d663bd873d93";
+
+static std::atomic<int> connects { 0 };
+static std::atomic<int> disconnects { 0 };
+static std::atomic<int> writes { 0 };
+static std::atomic<int> frames { 0 };
+static std::atomic<int> transactions { 0 };
+static std::atomic<int> advertisements { 0 };
+static std::atomic<int> finishes { 0 };
+
+static void onConnected() { connects++; }
+static void onDisconnected() { disconnects++; }
+static void onWrite(uint64_t, int) { writes++; }
+static void onData(const char*, uint32_t) { frames++; }
+static void onTransact(uint64_t, int, const char*, uint32_t) { transactions++; }
+static void onDiscovered(DeviceInfo) { advertisements++; }
+static void onFinished() { finishes++; }
+
+static bool waitFor(const std::atomic<int>& counter, int target, int timeout = 10000) {
+    QElapsedTimer timer;
+    timer.start();
+    while (counter < target) {
+        if (timer.elapsed() > timeout) return false;
+        std::this_thread::yield();
+    }
+
+    return true;
+}
+
+static Result summarize(const QString& name, const QString& unit, std::vector<double> samples, double seconds) {
+    Result result { name, unit, static_cast<int>(samples.size()), 0, 0, 0, 0, 0, 0 };
+    if (samples.empty()) return result;
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double sample : samples) total += sample;
+    result.mean = total / samples.size();
+    result.p50 = samples[samples.size() / 2];
+    result.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    result.min = samples.front();
+    result.max = samples.back();
+    result.rate = seconds > 0 ? samples.size() / seconds : 0;
+    return result;
+}
+
+// for batches where only the total is known, mean is the time per item
+static Result throughput(const QString& name, int count, double seconds) {
+    double each = count ? seconds * 1e9 / count : 0;
+    return Result { name, "ns", count, each, 0, 0, 0, 0, seconds > 0 ? count / seconds : 0 };
+}
+
+static double elapsedSeconds(const QElapsedTimer& timer) {
+    return timer.nsecsElapsed() / 1e9;
+}
+
+static LoopbackConfig fastConfig() {
+    LoopbackConfig config;
+    GetLoopbackConfig(&config);
+    config.ConnectLatency = 0;
+    config.Latency = 0;
+    config.Jitter = 0;
+    config.ChunkSize = 0;
+    config.ChunkInterval = 0;
+    config.DropRate = 0;
+    config.DisconnectRate = 0;
+    config.AdvertisingInterval = 0;
+    return config;
+}
+
+static QList<Result> benchmarkClassic(int iterations) {
+    QList<Result> results;
+    const char battery[] = { '\xAA', '\x01', '\xD0', '\x21', '\x94' };
+    auto manager = CreateBluetoothClassic();
+
+    std::vector<double> samples;
+    QElapsedTimer total;
+    total.start();
+    for (int i = 0; i < iterations; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        int target = connects + 1;
+        SetClassicConnectedCallback(manager, onConnected);
+        SetClassicDisconnectedCallback(manager, onDisconnected);
+        ClassicConnect(manager, ClassicAddress);
+        if (!waitFor(connects, target)) break;
+        samples.push_back(timer.nsecsElapsed() / 1e3);
+        if (i + 1 == iterations) break;
+        ClassicDisconnect(manager);
+    }
+
+    results.append(summarize("classic_connect_to_ready", "us", samples, elapsedSeconds(total)));
+    SetClassicWriteCallback(manager, onWrite);
+    SetClassicDataCallback(manager, onData);
+    SetClassicTransactCallback(manager, onTransact);
+
+    // cost of the exported call itself, completion is measured separately
+    samples.clear();
+    int written = writes;
+    int received = frames;
+    total.restart();
+    for (int i = 0; i < iterations; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        ClassicWrite(manager, battery, sizeof(battery));
+        samples.push_back(timer.nsecsElapsed());
+    }
+
+    results.append(summarize("classic_write_call", "ns", samples, elapsedSeconds(total)));
+    waitFor(writes, written + iterations);
+    results.append(throughput("classic_write_completion", writes - written, elapsedSeconds(total)));
+    waitFor(frames, received + iterations);
+    results.append(throughput("classic_data_callback", frames - received, elapsedSeconds(total)));
+
+    samples.clear();
+    total.restart();
+    for (int i = 0; i < iterations; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        int target = transactions + 1;
+        ClassicTransact(manager, battery, sizeof(battery), 0xD0, 1000);
+        if (!waitFor(transactions, target)) break;
+        samples.push_back(timer.nsecsElapsed() / 1e3);
+    }
+
+    results.append(summarize("classic_round_trip", "us", samples, elapsedSeconds(total)));
+    ClassicDisconnect(manager);
+    DestroyBluetoothClassic(manager);
+    return results;
+}
+
+static QList<Result> benchmarkLowEnergy(int iterations) {
+    QList<Result> results;
+    const char battery[] = { '\xAA', '\x01', '\xD0', '\x21', '\x94' };
+    auto manager = CreateBluetoothLowEnergy();
+
+    std::vector<double> samples;
+    QElapsedTimer total;
+    total.start();
+    for (int i = 0; i < iterations; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        int target = connects + 1;
+        SetLowEnergyConnectedCallback(manager, onConnected);
+        SetLowEnergyDisconnectedCallback(manager, onDisconnected);
+        LowEnergyConnect(manager, "", LowEnergyAddress, ServiceUuid, WriteUuid, ReadUuid);
+        if (!waitFor(connects, target)) break;
+        samples.push_back(timer.nsecsElapsed() / 1e3);
+        if (i + 1 == iterations) break;
+        LowEnergyDisconnect(manager);
+    }
+
+    results.append(summarize("le_connect_to_ready", "us", samples, elapsedSeconds(total)));
+    SetLowEnergyWriteCallback(manager, onWrite);
+    SetLowEnergyDataCallback(manager, onData);
+    SetLowEnergyTransactCallback(manager, onTransact);
+
+    samples.clear();
+    int written = writes;
+    total.restart();
+    for (int i = 0; i < iterations; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        LowEnergyWrite(manager, battery, sizeof(battery));
+        samples.push_back(timer.nsecsElapsed());
+    }
+
+    results.append(summarize("le_write_call", "ns", samples, elapsedSeconds(total)));
+    waitFor(writes, written + iterations);
+    results.append(throughput("le_write_completion", writes - written, elapsedSeconds(total)));
+
+    samples.clear();
+    total.restart();
+    for (int i = 0; i < iterations; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        int target = transactions + 1;
+        LowEnergyTransact(manager, battery, sizeof(battery), 0xD0, 1000);
+        if (!waitFor(transactions, target)) break;
+        samples.push_back(timer.nsecsElapsed() / 1e3);
+    }
+
+    results.append(summarize("le_round_trip", "us", samples, elapsedSeconds(total)));
+    LowEnergyDisconnect(manager);
+    DestroyBluetoothLowEnergy(manager);
+    return results;
+}
+
+static QList<Result> benchmarkDispatch(int iterations) {
+    QList<Result> results;
+    // any executor pinned object will do as the target thread
+    auto target = CreateDiscovery();
+
+    std::vector<double> samples;
+    QElapsedTimer total;
+    total.start();
+    for (int i = 0; i < iterations; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        QMetaObject::invokeMethod(target, []() { }, Qt::BlockingQueuedConnection);
+        samples.push_back(timer.nsecsElapsed());
+    }
+
+    results.append(summarize("dispatch_blocking", "ns", samples, elapsedSeconds(total)));
+
+    // calls still queued after a timeout run once we're gone, they share the counter
+    auto handled = std::make_shared<std::atomic<int>>(0);
+    total.restart();
+    for (int i = 0; i < iterations; i++)
+        QMetaObject::invokeMethod(target, [handled]() { (*handled)++; }, Qt::QueuedConnection);
+    waitFor(*handled, iterations);
+    results.append(throughput("dispatch_queued", *handled, elapsedSeconds(total)));
+
+    DestroyDiscovery(target);
+    return results;
+}
+
+static QList<Result> benchmarkDiscovery(int iterations) {
+    QList<Result> results;
+    for (int i = 0; i < iterations; i++) {
+        QByteArray address = QStringLiteral("0A:ED:1F:01:%1:%2")
+            .arg((i >> 8) & 0xFF, 2, 16, QChar('0')).arg(i & 0xFF, 2, 16, QChar('0')).toUpper().toLatin1();
+        AddLoopbackDevice("EDIFIER Bench", address.constData(), i % 2, nullptr, 2016, "\x0A\xED\x1F\x00\x00\x00\x01\x00", 8);
+    }
+
+    auto discovery = CreateDiscovery();
+    SetDeviceDiscoveredCallback(discovery, onDiscovered);
+    SetDiscoveryFinishedCallback(discovery, onFinished);
+
+    int reported = advertisements;
+    int target = finishes + 1;
+    QElapsedTimer total;
+    total.start();
+    StartDiscovery(discovery);
+    waitFor(finishes, target, 60000);
+    results.append(throughput("discovery_callback", advertisements - reported, elapsedSeconds(total)));
+
+    DestroyDiscovery(discovery);
+    return results;
+}
+
+static void writeJson(const QString& path, const QList<Result>& results) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return;
+    QTextStream out(&file);
+    out << "[\n";
+    for (int i = 0; i < results.length(); i++) {
+        auto& r = results.at(i);
+        out << QString("  {\"name\": \"%1\", \"unit\": \"%2\", \"samples\": %3, \"mean\": %4, \"p50\": %5, \"p99\": %6, \"min\": %7, \"max\": %8, \"rate\": %9}")
+            .arg(r.name, r.unit).arg(r.samples).arg(r.mean).arg(r.p50).arg(r.p99).arg(r.min).arg(r.max).arg(r.rate);
+        out << (i + 1 < results.length() ? ",\n" : "\n");
+    }
+
+    out << "]\n";
+}
+
+static void writeCsv(const QString& path, const QList<Result>& results) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return;
+    QTextStream out(&file);
+    out << "name,unit,samples,mean,p50,p99,min,max,rate\n";
+    for (auto& r : results)
+        out << QString("%1,%2,%3,%4,%5,%6,%7,%8,%9\n")
+            .arg(r.name, r.unit).arg(r.samples).arg(r.mean).arg(r.p50).arg(r.p99).arg(r.min).arg(r.max).arg(r.rate);
+}
+
+int main(int argc, char** argv) {
+    int iterations = 1000;
+    QString json;
+    QString csv;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--json") && i + 1 < argc) json = argv[++i];
+        else if (!strcmp(argv[i], "--csv") && i + 1 < argc) csv = argv[++i];
+    }
+
+    SetLoopbackEnabled(true);
+    LoopbackConfig config = fastConfig();
+    SetLoopbackConfig(&config);
+
+    std::thread loop([]() { RunApplication(); });
+    while (!GetApplication()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    QList<Result> results;
+    results.append(benchmarkDispatch(iterations));
+    results.append(benchmarkClassic(iterations));
+    results.append(benchmarkLowEnergy(iterations));
+    results.append(benchmarkDiscovery(iterations));
+
+    for (auto& r : results)
+        printf("%-26s %8d samples  mean %12.1f %-5s  p50 %12.1f  p99 %12.1f  rate %12.1f/s\n",
+            qPrintable(r.name), r.samples, r.mean, qPrintable(r.unit), r.p50, r.p99, r.rate);
+    if (!json.isEmpty()) writeJson(json, results);
+    if (!csv.isEmpty()) writeCsv(csv, results);
+
+    ExitApplication(0);
+    loop.join();
+    return 0;
+}
@@ -0,0 +1,312 @@
+#include "Broker.h"
+
+#include <BrokerProtocol.h>
+#include <BluetoothClassic.h>
+#include <BluetoothLowEnergy.h>
+#include <QtEndian>
+#include <QTimer>
+
+#if defined(_WIN32)
+#include <QWinEventNotifier>
+#else
+#include <QSocketNotifier>
+#endif
+
+Broker::Broker(QObject* parent) : QObject(parent), events(64) {
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(server, &QLocalServer::newConnection, this, &Broker::onNewConnection);
+
+    // every device reports through the event queue, Source tells them apart
+    EnableEventQueue(1024);
+#if defined(_WIN32)
+    auto notifier = new QWinEventNotifier(reinterpret_cast<Qt::HANDLE>(GetEventQueueHandle()), this);
+    connect(notifier, &QWinEventNotifier::activated, this, &Broker::onEvents);
+#else
+    auto notifier = new QSocketNotifier(GetEventQueueHandle(), QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &Broker::onEvents);
+#endif
+}
+
+Broker::~Broker() {
+    for (Device* device : devices) {
+        if (device->kind == BrokerClassic) DestroyBluetoothClassic(static_cast<BluetoothClassic*>(device->manager));
+        else DestroyBluetoothLowEnergy(static_cast<BluetoothLowEnergy*>(device->manager));
+        delete device;
+    }
+}
+
+bool Broker::listen(const QString& path) {
+    // a broker that died leaves its socket file behind
+    QLocalServer::removeServer(path);
+    return server->listen(path);
+}
+
+void Broker::onNewConnection() {
+    while (QLocalSocket* client = server->nextPendingConnection()) {
+        buffers.insert(client, QByteArray());
+        connect(client, &QLocalSocket::readyRead, this, [this, client]() {
+            onReadyRead(client);
+        });
+        connect(client, &QLocalSocket::disconnected, this, [this, client]() {
+            onClientGone(client);
+        });
+    }
+}
+
+void Broker::onEvents() {
+    uint32_t count;
+    while ((count = DrainEvents(events.data(), events.size())) > 0)
+        for (uint32_t i = 0; i < count; i++)
+            dispatch(events[i]);
+
+    // a full queue drops events without saying whose, any pending request
+    // might have lost its completion and would wait forever
+    EventQueueStats stats;
+    GetEventQueueStats(&stats);
+    if (stats.Dropped == dropped) return;
+    dropped = stats.Dropped;
+    failPending(BrokerEventsLost);
+}
+
+void Broker::onReadyRead(QLocalSocket* client) {
+    QByteArray& buffer = buffers[client];
+    buffer.append(client->readAll());
+    while (buffer.size() >= 4) {
+        uint32_t length = qFromLittleEndian<quint32>(buffer.constData());
+        if (length < 5 || length > BrokerMaxMessage) {
+            // out of step with the client, nothing after this can be trusted
+            client->abort();
+            return;
+        }
+
+        if (static_cast<uint32_t>(buffer.size()) < length + 4) return;
+        QByteArray body = buffer.mid(4, length);
+        buffer.remove(0, length + 4);
+        handle(client, body);
+    }
+}
+
+void Broker::onClientGone(QLocalSocket* client) {
+    buffers.remove(client);
+    for (Device* device : devices) device->subscribers.remove(client);
+    // answers still on their way have nobody to go to
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (it->client == client) it = pending.erase(it);
+        else ++it;
+    }
+
+    client->deleteLater();
+}
+
+void Broker::handle(QLocalSocket* client, const QByteArray& body) {
+    uint8_t opcode = static_cast<uint8_t>(body[0]);
+    uint32_t tag = qFromLittleEndian<quint32>(body.constData() + 1);
+    QByteArray fields = body.mid(5);
+    switch (opcode) {
+    case BrokerAttach:
+        attach(client, tag, fields);
+        return;
+    case BrokerDetach:
+        detach(client, tag, fields);
+        return;
+    case BrokerWrite:
+    case BrokerTransact:
+        break;
+    default:
+        reply(client, tag, BrokerBadRequest);
+        return;
+    }
+
+    int header = opcode == BrokerWrite ? 4 : 12;
+    if (fields.size() < header) {
+        reply(client, tag, BrokerBadRequest);
+        return;
+    }
+
+    Device* device = devices.value(qFromLittleEndian<quint32>(fields.constData()));
+    if (!device || !device->subscribers.contains(client)) {
+        reply(client, tag, BrokerUnknownDevice);
+        return;
+    }
+
+    // a torn down manager is muted until it's opened again, its completion
+    // would never reach us
+    if (!device->connected) {
+        reply(client, tag, BrokerNotConnected);
+        return;
+    }
+
+    QByteArray frame = fields.mid(header);
+    uint64_t id;
+    if (opcode == BrokerWrite) {
+        id = device->kind == BrokerClassic
+            ? ClassicWriteAsync(static_cast<BluetoothClassic*>(device->manager), frame.constData(), frame.size())
+            : LowEnergyWriteAsync(static_cast<BluetoothLowEnergy*>(device->manager), frame.constData(), frame.size());
+    } else {
+        int32_t responseType = qFromLittleEndian<qint32>(fields.constData() + 4);
+        int32_t timeout = qFromLittleEndian<qint32>(fields.constData() + 8);
+        id = device->kind == BrokerClassic
+            ? ClassicTransact(static_cast<BluetoothClassic*>(device->manager), frame.constData(), frame.size(), responseType, timeout)
+            : LowEnergyTransact(static_cast<BluetoothLowEnergy*>(device->manager), frame.constData(), frame.size(), responseType, timeout);
+    }
+
+    // completions are drained on this thread, the entry is in before them
+    pending.insert(id, Pending { client, tag });
+}
+
+void Broker::attach(QLocalSocket* client, uint32_t tag, const QByteArray& fields) {
+    if (fields.isEmpty()) {
+        reply(client, tag, BrokerBadRequest);
+        return;
+    }
+
+    int kind = static_cast<uint8_t>(fields[0]);
+    QList<QByteArray> strings = fields.mid(1).split('\0');
+    int needed = kind == BrokerClassic ? 1 : 4;
+    if ((kind != BrokerClassic && kind != BrokerLowEnergy) || strings.size() < needed) {
+        reply(client, tag, BrokerBadRequest);
+        return;
+    }
+
+    QByteArray key = QByteArray::number(kind) + ':' + strings[0].toUpper();
+    Device* device = addresses.value(key);
+    if (!device) {
+        device = new Device {
+            nextHandle++, kind, strings[0], QByteArray(), QByteArray(), QByteArray(),
+            nullptr, false, false, QSet<QLocalSocket*>()
+        };
+
+        ReconnectPolicy policy { 1, 100, 5000, 0 };
+        if (kind == BrokerClassic) {
+            auto manager = CreateBluetoothClassic();
+            SetClassicReconnectPolicy(manager, &policy);
+            device->manager = manager;
+        } else {
+            device->service = strings[1];
+            device->write = strings[2];
+            device->read = strings[3];
+            auto manager = CreateBluetoothLowEnergy();
+            SetLowEnergyReconnectPolicy(manager, &policy);
+            device->manager = manager;
+        }
+
+        devices.insert(device->handle, device);
+        addresses.insert(key, device);
+        sources.insert(reinterpret_cast<uintptr_t>(device->manager), device);
+        open(device);
+    }
+
+    device->subscribers.insert(client);
+    QByteArray result(4, 0);
+    qToLittleEndian<quint32>(device->handle, result.data());
+    reply(client, tag, BrokerOk, result);
+    if (device->connected) {
+        Event event {};
+        event.Type = EventConnected;
+        notify(device, event, client);
+    }
+}
+
+void Broker::detach(QLocalSocket* client, uint32_t tag, const QByteArray& fields) {
+    Device* device = fields.size() < 4 ? nullptr : devices.value(qFromLittleEndian<quint32>(fields.constData()));
+    if (!device || !device->subscribers.remove(client)) {
+        reply(client, tag, BrokerUnknownDevice);
+        return;
+    }
+
+    reply(client, tag, BrokerOk);
+}
+
+void Broker::open(Device* device) {
+    device->retrying = false;
+    if (device->kind == BrokerClassic) {
+        ClassicConnect(static_cast<BluetoothClassic*>(device->manager), device->address.constData());
+        return;
+    }
+
+    // the manager keeps these pointers, the device owns the strings
+    LowEnergyConnect(static_cast<BluetoothLowEnergy*>(device->manager), "", device->address.constData(),
+                     device->service.constData(), device->write.constData(), device->read.constData());
+}
+
+void Broker::lost(Device* device) {
+    device->connected = false;
+    if (device->retrying) return;
+    device->retrying = true;
+    uint32_t key = device->handle;
+    QTimer::singleShot(RetryInterval, this, [this, key]() {
+        if (Device* device = devices.value(key)) open(device);
+    });
+}
+
+void Broker::failPending(int32_t status) {
+    for (const Pending& request : pending) reply(request.client, request.tag, status);
+    pending.clear();
+}
+
+void Broker::dispatch(const Event& event) {
+    if (event.Type == EventWrite || event.Type == EventTransact) {
+        auto it = pending.find(event.Id);
+        if (it == pending.end()) return;
+        Pending request = it.value();
+        pending.erase(it);
+        int32_t status = event.Flags & EventTruncated ? BrokerTruncated : event.Code;
+        reply(request.client, request.tag, status,
+              event.Type == EventTransact ? QByteArray(event.Payload, event.Length) : QByteArray());
+        return;
+    }
+
+    Device* device = sources.value(event.Source);
+    if (!device) return;
+    switch (event.Type) {
+    case EventConnected:
+    case EventResumed:
+        device->connected = true;
+        break;
+    case EventDisconnected:
+    case EventError:
+        // either one means the supervisor gave up and the link was torn down
+        lost(device);
+        break;
+    case EventData:
+    case EventStateChanged:
+        break;
+    default:
+        return;
+    }
+
+    notify(device, event);
+}
+
+void Broker::notify(Device* device, const Event& event, QLocalSocket* only) {
+    QByteArray fields(16, 0);
+    qToLittleEndian<quint32>(device->handle, fields.data());
+    qToLittleEndian<quint32>(event.Type, fields.data() + 4);
+    qToLittleEndian<qint32>(event.Code, fields.data() + 8);
+    qToLittleEndian<quint32>(event.Flags, fields.data() + 12);
+    fields.append(event.Payload, event.Length);
+    if (only) {
+        write(only, BrokerNotify, 0, fields);
+        return;
+    }
+
+    for (QLocalSocket* client : device->subscribers)
+        write(client, BrokerNotify, 0, fields);
+}
+
+void Broker::reply(QLocalSocket* client, uint32_t tag, int32_t status, const QByteArray& data) {
+    QByteArray fields(4, 0);
+    qToLittleEndian<qint32>(status, fields.data());
+    fields.append(data);
+    write(client, BrokerReply, tag, fields);
+}
+
+void Broker::write(QLocalSocket* client, uint8_t opcode, uint32_t tag, const QByteArray& fields) {
+    QByteArray message(9, 0);
+    qToLittleEndian<quint32>(fields.size() + 5, message.data());
+    message[4] = static_cast<char>(opcode);
+    qToLittleEndian<quint32>(tag, message.data() + 5);
+    message.append(fields);
+    client->write(message);
+}
@@ -0,0 +1,78 @@
+#ifndef BROKER_H
+#define BROKER_H
+
+#include <EventQueue.h>
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <cstdint>
+
+// Owns the device links on behalf of every local client. Links are opened
+// on the first attach and kept, supervised, for as long as the broker runs;
+// later clients join the existing link without touching the radio. The
+// library's transactor already keeps one request in flight per device, the
+// broker only remembers which client each write or transaction belongs to.
+class Broker : public QObject {
+    Q_OBJECT
+
+public:
+    // a dropped link that ran out of retries is opened again after this
+    static constexpr int RetryInterval = 5000;
+
+    explicit Broker(QObject* parent = nullptr);
+    ~Broker() override;
+
+    bool listen(const QString& path);
+
+private slots:
+    void onNewConnection();
+    void onEvents();
+
+private:
+    struct Device {
+        uint32_t handle;
+        int kind;
+        QByteArray address;
+        QByteArray service;
+        QByteArray write;
+        QByteArray read;
+        void* manager;
+        bool connected;
+        bool retrying;
+        QSet<QLocalSocket*> subscribers;
+    };
+
+    struct Pending {
+        QLocalSocket* client;
+        uint32_t tag;
+    };
+
+    void onReadyRead(QLocalSocket* client);
+    void onClientGone(QLocalSocket* client);
+    void handle(QLocalSocket* client, const QByteArray& body);
+    void attach(QLocalSocket* client, uint32_t tag, const QByteArray& fields);
+    void detach(QLocalSocket* client, uint32_t tag, const QByteArray& fields);
+
+    void open(Device* device);
+    void lost(Device* device);
+    void failPending(int32_t status);
+    void dispatch(const Event& event);
+    void notify(Device* device, const Event& event, QLocalSocket* only = nullptr);
+    void reply(QLocalSocket* client, uint32_t tag, int32_t status, const QByteArray& data = QByteArray());
+    void write(QLocalSocket* client, uint8_t opcode, uint32_t tag, const QByteArray& fields);
+
+    QLocalServer* server;
+    QVector<Event> events;
+    QHash<uint32_t, Device*> devices;
+    QHash<QByteArray, Device*> addresses;
+    QHash<uint64_t, Device*> sources;
+    QHash<uint64_t, Pending> pending;
+    QHash<QLocalSocket*, QByteArray> buffers;
+    uint32_t nextHandle = 1;
+    uint64_t dropped = 0;
+};
+
+#endif // BROKER_H
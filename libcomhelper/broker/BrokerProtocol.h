@@ -0,0 +1,52 @@
+#ifndef BROKERPROTOCOL_H
+#define BROKERPROTOCOL_H
+
+#include <cstdint>
+
+// Wire format between the broker and its clients. Every message is a
+// 32-bit body length followed by the body: an opcode byte, a 32-bit tag
+// the client picks to match replies to requests, then the opcode's fields.
+// All integers are little-endian.
+enum BrokerOpcode : uint8_t {
+    // BrokerKind byte, then the NUL terminated address and for
+    // LE the service, write and read uuids; the reply carries the device
+    // handle and a Connected notification follows when the link is up
+    BrokerAttach = 1,
+    // device handle; the link stays up for the other clients and later ones
+    BrokerDetach = 2,
+    // device handle, frame; replied to once written
+    BrokerWrite = 3,
+    // device handle, response type (int32), timeout (int32), frame;
+    // replied to with the response frame, or with its head and
+    // BrokerTruncated when it was longer than an event carries
+    BrokerTransact = 4,
+    // int32 status, then the result of the request with the same tag
+    BrokerReply = 0x81,
+    // tag 0: device handle, event type, code (int32), event flags, data;
+    // sent to every client attached to the device
+    BrokerNotify = 0x82
+};
+
+enum BrokerKind : uint8_t {
+    BrokerClassic = 0,
+    BrokerLowEnergy = 1
+};
+
+// replies to writes and transactions carry a WriteStatus
+enum BrokerStatus {
+    BrokerOk = 0,
+    BrokerBadRequest = -16,
+    BrokerUnknownDevice = -17,
+    // the link is down and being reopened
+    BrokerNotConnected = -18,
+    // the broker fell behind and lost completions, the request may or may
+    // not have reached the device
+    BrokerEventsLost = -19,
+    // the transaction succeeded but only the first EventPayloadSize bytes
+    // of the response came through
+    BrokerTruncated = -20
+};
+
+static constexpr uint32_t BrokerMaxMessage = 64 * 1024;
+
+#endif // BROKERPROTOCOL_H
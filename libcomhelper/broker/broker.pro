@@ -0,0 +1,21 @@
+QT += bluetooth network
+QT -= gui
+
+TEMPLATE = app
+TARGET = comhelper-broker
+CONFIG += c++17 console
+CONFIG -= app_bundle
+DESTDIR = ../build
+
+# Links against the library next to it, build the library first
+INCLUDEPATH += $$PWD/..
+LIBS += -L$$OUT_PWD/../build -lcomhelper
+unix:!macx: QMAKE_RPATHDIR += $$OUT_PWD/../build
+
+HEADERS += \
+    Broker.h \
+    BrokerProtocol.h
+
+SOURCES += \
+    Broker.cpp \
+    main.cpp
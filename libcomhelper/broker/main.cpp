@@ -0,0 +1,32 @@
+#include <Broker.h>
+#include <Loopback.h>
+#include <QCoreApplication>
+#include <QStandardPaths>
+#include <cstdio>
+#include <cstring>
+
+// Shares device links between local processes over a Unix domain socket,
+// see BrokerProtocol.h for the wire format.
+// Usage: comhelper-broker [--socket path] [--loopback]
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    QString path = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + QStringLiteral("/comhelper-broker.sock");
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--socket") && i + 1 < argc) path = QString::fromLocal8Bit(argv[++i]);
+        else if (!strcmp(argv[i], "--loopback")) SetLoopbackEnabled(true);
+        else {
+            fprintf(stderr, "usage: %s [--socket path] [--loopback]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Broker broker;
+    if (!broker.listen(path)) {
+        fprintf(stderr, "can't listen on %s\n", qPrintable(path));
+        return 1;
+    }
+
+    fprintf(stderr, "listening on %s\n", qPrintable(path));
+    return app.exec();
+}
@@ -31,15 +31,53 @@ QMAKE_EXTRA_TARGETS += copy_qt_libs
 QMAKE_POST_LINK += $$copy_qt_libs.commands
 
 HEADERS += \
+    AdapterManager.h \
     ApplicationLoop.h \
+    Arena.h \
     BluetoothAdapter.h \
     BluetoothClassic.h \
     BluetoothDiscovery.h \
-    BluetoothLowEnergy.h
+    BluetoothLowEnergy.h \
+    Capture.h \
+    Codec.h \
+    ConnectionMonitor.h \
+    DeviceRegistry.h \
+    EventQueue.h \
+    Executor.h \
+    FrameAssembler.h \
+    LinkTuner.h \
+    Loopback.h \
+    PollScheduler.h \
+    ReceiveRing.h \
+    SessionGroup.h \
+    StateCache.h \
+    Supervisor.h \
+    Trace.h \
+    Transactor.h \
+    WriteQueue.h
 
 SOURCES += \
+    AdapterManager.cpp \
     ApplicationLoop.cpp \
+    Arena.cpp \
     BluetoothAdapter.cpp \
     BluetoothClassic.cpp \
     BluetoothDiscovery.cpp \
-    BluetoothLowEnergy.cpp
+    BluetoothLowEnergy.cpp \
+    Capture.cpp \
+    Codec.cpp \
+    ConnectionMonitor.cpp \
+    DeviceRegistry.cpp \
+    EventQueue.cpp \
+    Executor.cpp \
+    FrameAssembler.cpp \
+    LinkTuner.cpp \
+    Loopback.cpp \
+    PollScheduler.cpp \
+    ReceiveRing.cpp \
+    SessionGroup.cpp \
+    StateCache.cpp \
+    Supervisor.cpp \
+    Trace.cpp \
+    Transactor.cpp \
+    WriteQueue.cpp
@@ -24,7 +24,10 @@ public partial class BluetoothAdapter {
     public string? AdapterAddress {
         get {
             var ptr = GetAdapterAddress(_wrapper);
-            return ptr == IntPtr.Zero ? null : Marshal.PtrToStringAuto(ptr);
+            if (ptr == IntPtr.Zero) return null;
+            var str = Marshal.PtrToStringAuto(ptr);
+            FreeResult(ptr);
+            return str;
         }
     }
     
@@ -72,6 +75,7 @@ public partial class BluetoothAdapter {
             addresses[i] = Marshal.PtrToStringAuto(ptr)!;
         }
 
+        FreeResult(st);
         return addresses;
     }
     
@@ -119,6 +123,9 @@ public partial class BluetoothAdapter {
     [LibraryImport("comhelper")]
     private static partial IntPtr GetConnectedDevices(IntPtr wrapper);
     
+    [LibraryImport("comhelper")]
+    private static partial void FreeResult(IntPtr result);
+    
     [StructLayout(LayoutKind.Sequential, CharSet = CharSet.Auto)]
     private struct ConnectedDevices {
         public IntPtr Addresses;
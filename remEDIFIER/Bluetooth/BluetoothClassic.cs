@@ -18,6 +18,16 @@ public partial class BluetoothClassic : IBluetooth {
     /// </summary>
     private bool _isConnected;
     
+    /// <summary>
+    /// Was unmanaged instance destroyed
+    /// </summary>
+    private bool _isDisposed;
+    
+    /// <summary>
+    /// Pending native transactions
+    /// </summary>
+    private readonly Dictionary<ulong, IBluetooth.TransactDelegate> _transactions = new();
+    
     /// <summary>
     /// Data received event
     /// </summary>
@@ -57,6 +67,11 @@ public partial class BluetoothClassic : IBluetooth {
     /// Connected callback
     /// </summary>
     private readonly DataCallback _dataCallback;
+    
+    /// <summary>
+    /// Transact callback
+    /// </summary>
+    private readonly TransactCallback _transactCallback;
 
     /// <summary>
     /// Creates a new bluetooth classic agent
@@ -69,6 +84,8 @@ public partial class BluetoothClassic : IBluetooth {
         SetDisconnectedCallback(_wrapper, Marshal.GetFunctionPointerForDelegate(_disconnectedCallback));
         SetErrorCallback(_wrapper, Marshal.GetFunctionPointerForDelegate(_errorCallback));
         SetDataCallback(_wrapper, Marshal.GetFunctionPointerForDelegate(_dataCallback));
+        _transactCallback = TransactHandler;
+        SetTransactCallback(_wrapper, Marshal.GetFunctionPointerForDelegate(_transactCallback));
     }
     
     /// <summary>
@@ -85,6 +102,7 @@ public partial class BluetoothClassic : IBluetooth {
     /// Disconnects from current device
     /// </summary>
     public void Disconnect() {
+        if (_isDisposed) return;
         Disconnect(_wrapper);
         DisconnectedHandler();
     }
@@ -99,6 +117,34 @@ public partial class BluetoothClassic : IBluetooth {
         fixed (byte* ptr = buf) Write(_wrapper, (IntPtr)ptr, (uint)buf.Length);
     }
 
+    /// <summary>
+    /// Queues a request and waits for a response natively
+    /// </summary>
+    /// <param name="buf">Buffer</param>
+    /// <param name="responseType">Response type, negative to not wait for one</param>
+    /// <param name="timeout">Timeout in milliseconds</param>
+    /// <param name="callback">Completion callback</param>
+    public unsafe void Transact(byte[] buf, int responseType, int timeout, IBluetooth.TransactDelegate callback) {
+        if (!_isConnected) throw new InvalidOperationException(
+            "Agent is not connected to a bluetooth device");
+        // the callback may fire before the id is registered otherwise
+        lock (_transactions) {
+            ulong id;
+            fixed (byte* ptr = buf) id = Transact(_wrapper, (IntPtr)ptr, (uint)buf.Length, responseType, timeout);
+            _transactions[id] = callback;
+        }
+    }
+
+    /// <summary>
+    /// Destroys the unmanaged instance and frees its worker thread slot
+    /// </summary>
+    public void Dispose() {
+        if (_isDisposed) return;
+        _isDisposed = true;
+        _isConnected = false;
+        DestroyBluetoothClassic(_wrapper);
+    }
+
     /// <summary>
     /// Internal device disconnected handler
     /// </summary>
@@ -147,9 +193,32 @@ public partial class BluetoothClassic : IBluetooth {
     /// </summary>
     public delegate void ErrorDelegate(string message, int code);
     
+    /// <summary>
+    /// Internal transaction completed handler
+    /// </summary>
+    /// <param name="id">Transaction ID</param>
+    /// <param name="status">Status</param>
+    /// <param name="data">Buffer</param>
+    /// <param name="length">Length</param>
+    private void TransactHandler(ulong id, int status, IntPtr data, uint length) {
+        IBluetooth.TransactDelegate? callback;
+        lock (_transactions) _transactions.Remove(id, out callback);
+        if (callback == null) return;
+        byte[]? buf = null;
+        if (data != IntPtr.Zero) {
+            buf = new byte[length];
+            Marshal.Copy(data, buf, 0, buf.Length);
+        }
+        
+        callback((TransactStatus)status, buf);
+    }
+    
     [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
     private delegate void DataCallback(IntPtr data, uint length);
     
+    [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+    private delegate void TransactCallback(ulong id, int status, IntPtr data, uint length);
+    
     [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
     private delegate void ErrorCallback(IntPtr message, int code);
     
@@ -159,6 +228,9 @@ public partial class BluetoothClassic : IBluetooth {
     [LibraryImport("comhelper")]
     private static partial IntPtr CreateBluetoothClassic();
     
+    [LibraryImport("comhelper")]
+    private static partial void DestroyBluetoothClassic(IntPtr wrapper);
+    
     [LibraryImport("comhelper", EntryPoint = "ClassicConnect")]
     private static partial void Connect(IntPtr wrapper, IntPtr address);
     
@@ -179,4 +251,10 @@ public partial class BluetoothClassic : IBluetooth {
     
     [LibraryImport("comhelper", EntryPoint = "ClassicWrite")]
     private static partial void Write(IntPtr wrapper, IntPtr data, uint length);
+    
+    [LibraryImport("comhelper", EntryPoint = "SetClassicTransactCallback")]
+    private static partial void SetTransactCallback(IntPtr wrapper, IntPtr callback);
+    
+    [LibraryImport("comhelper", EntryPoint = "ClassicTransact")]
+    private static partial ulong Transact(IntPtr wrapper, IntPtr data, uint length, int responseType, int timeout);
 }
\ No newline at end of file
@@ -3,13 +3,22 @@ namespace remEDIFIER.Bluetooth;
 /// <summary>
 /// Bluetooth communication method
 /// </summary>
-public interface IBluetooth {
+public interface IBluetooth : IDisposable {
     /// <summary>
     /// Writes a packet
     /// </summary>
     /// <param name="buf">Buffer</param>
     public void Write(byte[] buf);
 
+    /// <summary>
+    /// Queues a request and waits for a response natively
+    /// </summary>
+    /// <param name="buf">Buffer</param>
+    /// <param name="responseType">Response type, negative to not wait for one</param>
+    /// <param name="timeout">Timeout in milliseconds</param>
+    /// <param name="callback">Completion callback</param>
+    public void Transact(byte[] buf, int responseType, int timeout, TransactDelegate callback);
+
     /// <summary>
     /// Disconnects from the device
     /// </summary>
@@ -49,4 +58,39 @@ public interface IBluetooth {
     /// Data received delegate
     /// </summary>
     public delegate void DataReceivedDelegate(byte[] buf);
+    
+    /// <summary>
+    /// Transaction completed delegate
+    /// </summary>
+    public delegate void TransactDelegate(TransactStatus status, byte[]? buf);
+}
+
+/// <summary>
+/// Native transaction status
+/// </summary>
+public enum TransactStatus {
+    /// <summary>
+    /// Response was received
+    /// </summary>
+    Completed = 0,
+    
+    /// <summary>
+    /// Failed to write the request
+    /// </summary>
+    Failed = -1,
+    
+    /// <summary>
+    /// Device is not connected
+    /// </summary>
+    NotConnected = -2,
+    
+    /// <summary>
+    /// Connection was closed before completion
+    /// </summary>
+    Aborted = -3,
+    
+    /// <summary>
+    /// Response was not received in time
+    /// </summary>
+    TimedOut = -4
 }
\ No newline at end of file
@@ -25,14 +25,9 @@ public class EdifierClient {
     public bool Connected { get; private set; }
     
     /// <summary>
-    /// Packet queue
+    /// Response timeout in milliseconds
     /// </summary>
-    private readonly Queue<PacketWrapper> _packets = new();
-
-    /// <summary>
-    /// Packet wrapper we are currently waiting for
-    /// </summary>
-    private PacketWrapper? _waitingFor;
+    private const int ResponseTimeout = 5000;
     
     /// <summary>
     /// Bluetooth connection
@@ -103,8 +98,10 @@ public class EdifierClient {
         Log.Information("Disconnected from {0} ({1}, BLE: {2})",
             Device.Info.DeviceName, Device.Info.MacAddress, Device.Info.IsLowEnergyDevice);
         Connected = false;
-        _bluetooth.Disconnect();
+        var bluetooth = _bluetooth;
         _bluetooth = null;
+        bluetooth.Disconnect();
+        bluetooth.Dispose();
     }
     
     /// <summary>
@@ -112,85 +109,77 @@ public class EdifierClient {
     /// </summary>
     private void RegisterEvents() {
         if (Device == null) return;
-        _bluetooth!.DeviceConnected += () => {
+        var bluetooth = _bluetooth!;
+        bluetooth.DeviceConnected += () => {
             Connected = true;
-            new Thread(SenderThread).Start();
             new Thread(() => DeviceConnected?.Invoke()).Start();
         };
-        _bluetooth.DeviceDisconnected += () => {
-            _bluetooth = null;
+        bluetooth.DeviceDisconnected += () => {
+            if (_bluetooth == bluetooth) _bluetooth = null;
+            bluetooth.Dispose();
             Log.Information("Disconnected from {0} ({1}, BLE: {2})",
                 Device.Info.DeviceName, Device.Info.MacAddress, Device.Info.IsLowEnergyDevice);
             new Thread(() => DeviceDisconnected?.Invoke()).Start();
         };
-        _bluetooth.ErrorOccured += (err, code) => {
-            _bluetooth = null; Connected = false;
+        bluetooth.ErrorOccured += (err, code) => {
+            if (_bluetooth == bluetooth) _bluetooth = null;
+            Connected = false; bluetooth.Dispose();
             Log.Information("Disconnected with error {0} ({1})", err, code);
             new Thread(() => ErrorOccured?.Invoke(err, code)).Start();
             new Thread(() => DeviceDisconnected?.Invoke()).Start();
         };
-        _bluetooth.DataReceived += buf => {
-            var (type, data, payload) = Packet.Deserialize(buf, Support);
-            Log.Information("Received {0} with payload {1}", type, Convert.ToHexString(payload));
-            if (type == PacketType.GetSupportedFeatures) {
-                Support = (SupportData)data!;
-                Support.Extra = Device.Extra;
-            }
-            
-            if (_waitingFor == null || _waitingFor.Type != type) {
-                PacketReceived?.Invoke(type, data, payload);
-                return;
-            }
-            
-            _waitingFor.ReceivedPayload = payload;
-            _waitingFor.ReceivedData = data;
-            _waitingFor.State = PacketState.Received;
-            if (_waitingFor.NotifyListeners)
-                PacketReceived?.Invoke(type, data, payload);
-            _waitingFor = null;
+        bluetooth.DataReceived += buf => {
+            var (type, data, payload) = Receive(buf);
+            PacketReceived?.Invoke(type, data, payload);
         };
     }
 
     /// <summary>
-    /// Packet sender thread
+    /// Deserializes a received packet
     /// </summary>
-    private void SenderThread() {
-        while (true) {
-            while (_packets.Count == 0) {
-                if (!Connected) return;
-                Thread.Sleep(10);
-            }
-            
-            if (!Connected) return;
-            var packet = _packets.Dequeue();
-            if (packet.WaitForResponse)
-                _waitingFor = packet;
-            
-            try {
-                _bluetooth!.Write(packet.Sent);
-            } catch (Exception e) {
-                Log.Warning("Failed to send packet: {0}", e);
-                continue;
-            }
-            
-            packet.State = PacketState.Sent;
+    /// <param name="buf">Buffer</param>
+    /// <returns>Packet Type, Data, Raw Payload</returns>
+    private (PacketType, IPacketData?, byte[]) Receive(byte[] buf) {
+        var (type, data, payload) = Packet.Deserialize(buf, Support);
+        Log.Information("Received {0} with payload {1}", type, Convert.ToHexString(payload));
+        if (type == PacketType.GetSupportedFeatures) {
+            Support = (SupportData)data!;
+            Support.Extra = Device!.Extra;
+        }
+
+        return (type, data, payload);
+    }
 
-            // Trying to send multiple packets without waiting
-            // for a response will cause the headphones to disconnect
-            if (packet.WaitForResponse) {
-                var token = new CancellationTokenSource(TimeSpan.FromMilliseconds(5000));
-                while (packet.State != PacketState.Received) {
-                    if (!Connected) return;
-                    if (token.IsCancellationRequested) {
-                        Log.Warning("Receiving {0} has timed out", packet.Type);
-                        new Thread(() => PacketTimedOut?.Invoke(packet.Type)).Start();
-                        break;
-                    }
-                
-                    Thread.Sleep(10);
-                }
+    /// <summary>
+    /// Handles a completed native transaction
+    /// </summary>
+    /// <param name="packet">Packet wrapper</param>
+    /// <param name="status">Status</param>
+    /// <param name="buf">Response buffer</param>
+    private void Completed(PacketWrapper packet, TransactStatus status, byte[]? buf) {
+        switch (status) {
+            case TransactStatus.Completed when buf != null: {
+                var (type, data, payload) = Receive(buf);
+                packet.ReceivedPayload = payload;
+                packet.ReceivedData = data;
+                packet.State = PacketState.Received;
+                if (packet.NotifyListeners)
+                    PacketReceived?.Invoke(type, data, payload);
+                break;
             }
+            case TransactStatus.Completed:
+                packet.State = PacketState.Sent;
+                break;
+            case TransactStatus.TimedOut:
+                Log.Warning("Receiving {0} has timed out", packet.Type);
+                new Thread(() => PacketTimedOut?.Invoke(packet.Type)).Start();
+                break;
+            default:
+                Log.Warning("Failed to send {0}: {1}", packet.Type, status);
+                break;
         }
+        
+        packet.Done.Set();
     }
 
     /// <summary>
@@ -226,14 +215,21 @@ public class EdifierClient {
     /// <returns>Packet data</returns>
     public PacketWrapper Send(PacketType type, byte[] data, bool notify = false, bool wait = true, bool wantResponse = true) {
         var wrapper = new PacketWrapper(type, data, notify, wait);
-        _packets.Enqueue(wrapper);
-        if (!wantResponse || !wait) return wrapper;
-        var token = new CancellationTokenSource(TimeSpan.FromMilliseconds(5000));
-        while (wrapper.State != PacketState.Received) {
-            if (token.IsCancellationRequested) return wrapper;
-            Thread.Sleep(10);
+        var bluetooth = _bluetooth;
+        if (!Connected || bluetooth == null) return wrapper;
+        
+        // Trying to send multiple packets without waiting for a response will cause
+        // the headphones to disconnect, libcomhelper queues them until the previous one completes
+        try {
+            bluetooth.Transact(data, wait ? (int)type : -1, ResponseTimeout,
+                (status, buf) => Completed(wrapper, status, buf));
+        } catch (InvalidOperationException e) {
+            Log.Warning("Failed to send packet: {0}", e);
+            return wrapper;
         }
         
+        if (!wantResponse || !wait) return wrapper;
+        wrapper.Done.Wait(ResponseTimeout * 2);
         return wrapper;
     }
     
@@ -293,6 +289,11 @@ public class EdifierClient {
         /// Should we wait for a response
         /// </summary>
         public bool WaitForResponse { get; set; }
+        
+        /// <summary>
+        /// Set once the native transaction completes
+        /// </summary>
+        public ManualResetEventSlim Done { get; } = new();
 
         /// <summary>
         /// Creates a new packet wrapper